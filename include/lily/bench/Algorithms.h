@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fmt/format.h>
+#include <functional>
+#include <openssl/evp.h>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <lily/core/ErrorCode.h>
+
+namespace lily::bench
+{
+    /**
+     * @brief The key behind a TLS signature algorithm.
+     *
+     * A classical algorithm is named after its key type and its digest, such as `ECDSA+SHA384`. The ECDSA curve
+     * follows the digest, as in the TLS 1.3 signature schemes, and RSA keeps the OpenSSL default key size. A
+     * post-quantum algorithm is named after its key type, and has no separate digest.
+     */
+    struct SignatureKey
+    {
+        std::string algorithm {};
+        std::string digest {};
+        char const* curve {};
+    };
+
+    // Returns the key behind a signature algorithm of `SUPPORTED_SIGALGS_LIST`
+    SignatureKey getSignatureKey(std::string const& sigalg);
+
+    // Split a colon-separated list of algorithm names
+    std::vector<std::string> splitAlgorithms(std::string_view algorithms);
+
+    /**
+     * @brief Returns the selected algorithms, or fails when one of them is not in the supported list.
+     *
+     * A name holding a shell wildcard, such as `*mlkem*` or `p256_*`, selects every matching supported algorithm and
+     * fails when none matches. An algorithm selected twice is only returned once.
+     *
+     * @param kind The kind of algorithm, as written in the error message.
+     */
+    core::Expect<std::vector<std::string>> selectAlgorithms(std::string const& selected, std::string_view supported,
+                                                            std::string_view kind);
+
+    /**
+     * @brief Generate a key, with the curve of the classical ECDSA algorithms.
+     *
+     * Nothing is logged, so it can be measured in a loop. Returns `nullptr` when it fails.
+     */
+    EVP_PKEY* newKey(char const* algorithm, char const* curve = nullptr);
+
+    /**
+     * @brief Generate a self-signed certificate and its private key, in PEM format, the same way as `gen-pqc`.
+     *
+     * @return The certificate, then the private key.
+     */
+    core::Expect<std::pair<std::string, std::string>> generateCredentials(std::string const& sigalg);
+
+    /**
+     * @brief Run `work` on `threads` threads started at once, once they are all ready, and wait for all of them.
+     *
+     * Every thread is given its index and the time they all started at. With `cores`, thread `i` is pinned to the
+     * core `cores[i % cores.size()]`.
+     *
+     * @return The time from the start of the threads to the end of the last one.
+     */
+    std::chrono::duration<double> runThreads(
+        uint32_t threads, std::function<void(uint32_t, std::chrono::steady_clock::time_point)> const& work,
+        std::vector<int> const& cores = {});
+
+    /**
+     * @brief Write the results of a benchmark, or to `<start time>_<defaultSuffix>` when `path` is empty.
+     */
+    core::Expect<void> writeResultFile(std::filesystem::path path, std::string_view defaultSuffix,
+                                       fmt::memory_buffer const& buffer);
+} // namespace lily::bench
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <lily/core/Constants.h>
+#include <lily/core/ErrorCode.h>
+
+namespace lily::bench
+{
+    /**
+     * @brief The configuration used to create a `CryptoBench`.
+     */
+    struct CryptoBenchConfig
+    {
+        // The highest number of threads running a primitive concurrently. Every primitive is run on a single thread,
+        // then on every power of two below this number, then on this number.
+        uint32_t maxThreads {1};
+
+        // How long every primitive is run at every number of threads
+        std::chrono::milliseconds duration {500};
+
+        // The KEM groups and the signature algorithms to measure, separated by colons. Every supported one is measured
+        // by default, and an empty list measures none.
+        std::string groups {core::constants::SUPPORTED_PQC_GROUPS_LIST};
+        std::string sigalgs {core::constants::SUPPORTED_SIGALGS_LIST};
+
+        // The JSON file receiving the results. Empty writes them to the current working directory.
+        std::filesystem::path jsonOutputPath {};
+    };
+
+    /**
+     * @brief Measures the post-quantum primitives through the OpenSSL EVP APIs, the same way the TLS stack calls
+     * them.
+     *
+     * Every KEM group is measured on its key generation, encapsulation and decapsulation, and every signature
+     * algorithm on its key generation, signing and verification. Each primitive runs back-to-back on an increasing
+     * number of threads for a fixed duration, and its throughput, latency percentiles and scaling efficiency are
+     * reported along with the sizes of the key share, ciphertext, public key and signature, as a table and as JSON.
+     */
+    class CryptoBench
+    {
+    public:
+        /**
+         * @brief The measured primitives.
+         */
+        enum class Operation
+        {
+            KEYGEN,
+            ENCAPS,
+            DECAPS,
+            SIGN,
+            VERIFY,
+        };
+
+        /**
+         * @brief The measurement of a single primitive at a given number of threads.
+         */
+        struct Result
+        {
+            Operation operation {};
+            uint32_t threads {};
+            uint64_t operations {};
+            double opsPerSecond {};
+
+            // The latencies of a single call, in ns
+            uint64_t p50Ns {};
+            uint64_t p90Ns {};
+            uint64_t p99Ns {};
+            uint64_t maxNs {};
+
+            // The throughput relative to the single-thread throughput multiplied by the number of threads
+            double scalingEfficiency {};
+        };
+
+        /**
+         * @brief Every measurement of a KEM group or a signature algorithm.
+         */
+        struct Report
+        {
+            std::string algorithm {};
+            bool kem {};
+
+            // The key share sent in the TLS ClientHello for a KEM, the encoded SubjectPublicKeyInfo of the
+            // certificate for a signature algorithm
+            std::size_t publicKeySize {};
+
+            // The ciphertext of a KEM, the signature of a signature algorithm
+            std::size_t outputSize {};
+
+            // The shared secret of a KEM
+            std::size_t sharedSecretSize {};
+
+            std::vector<Result> results {};
+        };
+
+    private:
+        CryptoBenchConfig config;
+        std::vector<uint32_t> threadCounts;
+        std::vector<Report> reports;
+
+        // Measure every primitive of a single KEM group or signature algorithm
+        core::Expect<Report> measureKEM(std::string const& group) const;
+        core::Expect<Report> measureSignature(std::string const& sigalg) const;
+
+        // Print the measurements of an algorithm as rows of the results table
+        static void printResults(Report const& report);
+
+        // Print the sizes of every measured algorithm, and write every result as JSON
+        void printSizes() const;
+        core::Expect<void> writeJSON() const;
+
+    public:
+        explicit CryptoBench(CryptoBenchConfig const& config);
+
+        CryptoBench(CryptoBench const&)            = delete;
+        CryptoBench(CryptoBench&&)                 = delete;
+        CryptoBench& operator=(CryptoBench const&) = delete;
+        CryptoBench& operator=(CryptoBench&&)      = delete;
+
+        /**
+         * @brief Measures every selected algorithm, then prints and writes the results.
+         *
+         * An algorithm that cannot be set up, such as one disabled in the liboqs build, is skipped. The run fails when
+         * an unsupported algorithm is selected or when no algorithm could be measured.
+         */
+        core::Expect<void> run();
+
+        // Returns the name of a primitive, as written to the results
+        static char const* getOperationName(Operation operation);
+    };
+} // namespace lily::bench
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <lily/core/ErrorCode.h>
+
+namespace lily::bench
+{
+    /**
+     * @brief The configuration used to create a `DescriptorBench`.
+     */
+    struct DescriptorBenchConfig
+    {
+        // How long the descriptor requests of every algorithm run, both with and without the cache
+        std::chrono::milliseconds duration {100};
+
+        // The JSON file receiving the results. Empty writes them to the current working directory.
+        std::filesystem::path jsonOutputPath {};
+    };
+
+    /**
+     * @brief Measures what the descriptor cache saves on every request of the oqs-provider.
+     *
+     * For every KEM and signature algorithm enabled in liboqs, a descriptor is requested and released back-to-back,
+     * once allocated by `OQS_KEM_new` or `OQS_SIG_new` and once served by the cache. Multiplied by the descriptors
+     * requested per handshake, as reported by `bench-handshake`, it gives the time saved by every handshake.
+     */
+    class DescriptorBench
+    {
+    public:
+        /**
+         * @brief The measurement of the descriptor requests of a single algorithm.
+         */
+        struct Result
+        {
+            std::string kind {};
+            std::string algorithm {};
+
+            // The time of a request and its release, in ns
+            double allocatedNs {};
+            double cachedNs {};
+        };
+
+    private:
+        DescriptorBenchConfig config;
+        std::vector<Result> results;
+
+        // Write every result as JSON
+        core::Expect<void> writeJSON() const;
+
+    public:
+        explicit DescriptorBench(DescriptorBenchConfig const& config);
+
+        DescriptorBench(DescriptorBench const&)            = delete;
+        DescriptorBench(DescriptorBench&&)                 = delete;
+        DescriptorBench& operator=(DescriptorBench const&) = delete;
+        DescriptorBench& operator=(DescriptorBench&&)      = delete;
+
+        /**
+         * @brief Measures every enabled algorithm, then prints and writes the results.
+         *
+         * The descriptor cache must be built first.
+         */
+        core::Expect<void> run();
+    };
+} // namespace lily::bench
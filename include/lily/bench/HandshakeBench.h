@@ -0,0 +1,105 @@
+#pragma once
+
+#include <boost/asio/ssl.hpp>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <lily/core/Constants.h>
+#include <lily/core/ErrorCode.h>
+
+namespace lily::bench
+{
+    /**
+     * @brief The configuration used to create a `HandshakeBench`.
+     */
+    struct HandshakeBenchConfig
+    {
+        // The number of threads running handshakes concurrently, each pinned to its own core
+        uint32_t threads {1};
+
+        // How long the handshakes of every group and signature algorithm pair run
+        std::chrono::milliseconds duration {500};
+
+        // The KEM groups offered by the client and the signature algorithms of the server certificate, separated by
+        // colons. Every supported one is measured by default, and an empty list measures none.
+        std::string groups {core::constants::SUPPORTED_PQC_GROUPS_LIST};
+        std::string sigalgs {core::constants::SUPPORTED_SIGALGS_LIST};
+
+        // The certificate compression algorithms of both sides, separated by colons. Empty disables it.
+        std::string certCompression {};
+
+        // The JSON file receiving the results. Empty writes them to the current working directory.
+        std::filesystem::path jsonOutputPath {};
+    };
+
+    /**
+     * @brief Measures the CPU cost of complete TLS 1.3 handshakes, without any network.
+     *
+     * The server context is configured like `ServerListener`, with a self-signed certificate generated in memory for
+     * every signature algorithm, and the client context like `ClientConnection`, offering a single group. Both sides
+     * of every handshake run on the same thread and exchange their records through an in-memory BIO pair, so the
+     * measurement only covers the TLS stack and the primitives. The handshakes are sharded across the threads, each
+     * pinned to its own core.
+     */
+    class HandshakeBench
+    {
+    public:
+        /**
+         * @brief The measurement of the handshakes of a group and signature algorithm pair.
+         */
+        struct Result
+        {
+            std::string group {};
+            std::string sigalg {};
+            uint64_t handshakes {};
+            double handshakesPerSecond {};
+            double handshakesPerSecondPerCore {};
+
+            // The thread CPU time spent per handshake, both sides together, in µs
+            double cpuUsPerHandshake {};
+
+            // The latencies of a handshake in ns, both sides together and per side
+            uint64_t p50Ns {};
+            uint64_t p99Ns {};
+            uint64_t clientP50Ns {};
+            uint64_t serverP50Ns {};
+
+            // The bytes sent by each side, including the record headers and the session tickets of the server
+            uint64_t clientBytes {};
+            uint64_t serverBytes {};
+
+            // The liboqs descriptors requested by the oqs-provider, both sides together, see `DescriptorBench`
+            uint64_t oqsDescriptors {};
+        };
+
+    private:
+        HandshakeBenchConfig config;
+        std::vector<Result> results;
+
+        // Run handshakes between a server context and a client context on every thread
+        core::Expect<Result> measure(boost::asio::ssl::context& serverCtx, boost::asio::ssl::context& clientCtx,
+                                     std::string const& group, std::string const& sigalg) const;
+
+        // Write every result as JSON
+        core::Expect<void> writeJSON() const;
+
+    public:
+        explicit HandshakeBench(HandshakeBenchConfig const& config);
+
+        HandshakeBench(HandshakeBench const&)            = delete;
+        HandshakeBench(HandshakeBench&&)                 = delete;
+        HandshakeBench& operator=(HandshakeBench const&) = delete;
+        HandshakeBench& operator=(HandshakeBench&&)      = delete;
+
+        /**
+         * @brief Measures every selected group and signature algorithm pair, then prints and writes the results.
+         *
+         * A pair that cannot complete a handshake, such as one using an algorithm disabled in the liboqs build, is
+         * skipped. The run fails when an unsupported algorithm is selected or when no pair could be measured.
+         */
+        core::Expect<void> run();
+    };
+} // namespace lily::bench
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <lily/core/Constants.h>
+#include <lily/core/ErrorCode.h>
+#include <lily/net/LoadGenerator.h>
+
+namespace lily::bench
+{
+    /**
+     * @brief The configuration used to create a `Sweep`.
+     */
+    struct SweepConfig
+    {
+        // The load run against the server for every group and signature algorithm pair. Its TLS group is replaced by
+        // the swept one, and its duration or request limit bounds every pair.
+        net::LoadConfig load {};
+
+        // The KEM groups offered by the client and the signature algorithms of the server certificate, separated by
+        // colons. A name may hold shell wildcards, such as `*mlkem*`.
+        std::string groups {core::constants::SUPPORTED_PQC_GROUPS_LIST};
+        std::string sigalgs {core::constants::SUPPORTED_SIGALGS_LIST};
+
+        // The directory holding the `<sigalg>.crt` and `<sigalg>.key` credentials. The missing ones are generated and
+        // saved there. Empty generates every credential in memory.
+        std::filesystem::path credentialsDirectory {};
+
+        // The JSON file receiving the results. Empty writes them to the current working directory.
+        std::filesystem::path jsonOutputPath {};
+    };
+
+    /**
+     * @brief Runs the load against a live server for every KEM group and signature algorithm pair, in a single run.
+     *
+     * For every signature algorithm, the server certificate is replaced through the control target, so the server
+     * must run with the control enabled and is never restarted. Every group is then measured with a new
+     * `LoadGenerator`, and the results of every pair are printed in a single table at the end.
+     */
+    class Sweep
+    {
+    public:
+        /**
+         * @brief The measurement of the requests of a group and signature algorithm pair.
+         */
+        struct Result
+        {
+            std::string group {};
+            std::string sigalg {};
+            uint64_t successfulRequests {};
+            uint64_t failedRequests {};
+            double requestsPerSecond {};
+
+            // The latencies of the handshake and of the whole request, in µs
+            uint64_t handshakeP50Us {};
+            uint64_t handshakeP99Us {};
+            uint64_t p50Us {};
+            uint64_t p90Us {};
+            uint64_t p99Us {};
+
+            // The average handshake bytes sent and received by the client per handshake
+            uint64_t hsBytesSent {};
+            uint64_t hsBytesRecv {};
+        };
+
+    private:
+        SweepConfig config;
+        std::vector<Result> results;
+
+        // Load the credentials of a signature algorithm, generating the missing ones. Returns the PEM certificate
+        // followed by the PEM private key.
+        core::Expect<std::string> loadCredentials(std::string const& sigalg) const;
+
+        // Print every result as a single table
+        void print() const;
+
+        // Write every result as JSON
+        core::Expect<void> writeJSON() const;
+
+    public:
+        explicit Sweep(SweepConfig const& config);
+
+        Sweep(Sweep const&)            = delete;
+        Sweep(Sweep&&)                 = delete;
+        Sweep& operator=(Sweep const&) = delete;
+        Sweep& operator=(Sweep&&)      = delete;
+
+        /**
+         * @brief Measures every selected group and signature algorithm pair, then prints and writes the results.
+         *
+         * A signature algorithm whose credentials cannot be generated and a group whose load cannot run are skipped.
+         * The sweep stops early on interruption, keeping the results measured so far. It fails when an unsupported
+         * algorithm is selected, when the server rejects the certificate or when no pair could be measured.
+         */
+        core::Expect<void> run();
+    };
+} // namespace lily::bench
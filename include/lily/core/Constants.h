@@ -1,8 +1,19 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
 namespace lily::core::constants
 {
+    static constexpr std::chrono::seconds STATS_REPORT_INTERVAL {5};
+    static constexpr std::chrono::milliseconds OPEN_LOOP_SLOT_TOLERANCE {1};
+    static constexpr std::chrono::milliseconds ACCEPT_RETRY_DELAY {100};
+    static constexpr std::size_t BODY_CHUNK_SIZE {64 * 1024};
+    static constexpr int TCP_FASTOPEN_QUEUE_LENGTH {4096};
     static constexpr char const* DEFAULT_SERVER_HOST {"0.0.0.0"};
+    static constexpr char const* CONTROL_CREDENTIALS_TARGET {"/control/credentials"};
+    static constexpr std::uint64_t CONTROL_BODY_LIMIT {256 * 1024};
     static constexpr char const* SUPPORTED_SIGALGS_LIST {
         // Supported classical algorithms
         "RSA+SHA256:RSA+SHA384:RSA+SHA512:ECDSA+SHA384:ECDSA+SHA512:"
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <oqs/oqs.h>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace lily::crypto
+{
+    /**
+     * @brief A pool of KEM key pairs generated ahead of the handshakes, for the load generation only.
+     *
+     * Once started, every `OQS_KEM_keypair` call of the oqs-provider takes a key pair from the pool of its algorithm
+     * instead of generating one, so the heavy key generation of the client leaves the request path. Background
+     * threads keep every pool full. An algorithm gets its pool on its first key generation, which misses, as does
+     * every generation while its pool is empty. Every key pair is still used by a single handshake only.
+     *
+     * The pools of every algorithm enabled in liboqs are created once by `start()`, so a key generation finds its
+     * pool without a lock and only takes the lock of that pool. The background threads are only woken up when a pool
+     * is first used or drops below half of its capacity.
+     *
+     * The classical half of a hybrid group is generated by OpenSSL itself, and is not pooled.
+     */
+    class KeysharePool
+    {
+    public:
+        /**
+         * @brief The key pairs taken from the pool of an algorithm, and the generations that found it empty.
+         */
+        struct Statistics
+        {
+            std::string algorithm {};
+            uint64_t hits {};
+            uint64_t misses {};
+        };
+
+    private:
+        struct AlgorithmPool
+        {
+            // Lives as long as the pool, the fillers keep using it outside of any lock
+            std::unique_ptr<OQS_KEM, decltype(&OQS_KEM_free)> kem;
+
+            // Guards the key pairs and the statistics of this algorithm only
+            mutable std::mutex mtx {};
+
+            // Every key pair holds the public key followed by the secret key
+            std::deque<std::vector<uint8_t>> keys {};
+            uint64_t hits {};
+            uint64_t misses {};
+
+            // The key pairs in the pool or being generated, reserved by the fillers under the lock of the pool set
+            std::atomic_size_t available {};
+
+            // Set once a handshake used the algorithm, only then is it filled
+            std::atomic_bool requested {};
+
+            // Set once a generation failed, the algorithm is then no longer filled
+            std::atomic_bool failed {};
+        };
+
+        // Guards the fillers looking for a pool to fill, and their wake-ups
+        std::mutex mtx;
+        std::condition_variable_any keysNeeded;
+
+        // Created once by the first `start()`, then only read without a lock
+        std::map<std::string, std::unique_ptr<AlgorithmPool>, std::less<>> pools;
+        std::atomic_bool enabled {};
+        std::size_t capacity {};
+        std::size_t lowWater {};
+        std::vector<std::jthread> threads;
+
+        KeysharePool() = default;
+
+        KeysharePool(KeysharePool const&)            = delete;
+        KeysharePool(KeysharePool&&)                 = delete;
+        KeysharePool& operator=(KeysharePool const&) = delete;
+        KeysharePool& operator=(KeysharePool&&)      = delete;
+
+        // Returns the used pool missing the most key pairs, if any is not full. The lock must be held.
+        AlgorithmPool* findEmptiest();
+
+        // Wake the fillers up, after a pool was first used or dropped below its low-water mark
+        void notifyFillers();
+
+        // Generate key pairs into the pools until stopped
+        void fill(std::stop_token stopToken);
+
+    public:
+        static KeysharePool& getInstance();
+
+        /**
+         * @brief Starts the background threads keeping up to `capacity` key pairs per algorithm.
+         *
+         * Must not be called while handshakes are running, the pools of a previous start are emptied.
+         */
+        void start(std::size_t capacity, uint32_t threads);
+
+        /**
+         * @brief Stops the background threads. The key generation then no longer uses the pools.
+         */
+        void stop();
+
+        /**
+         * @brief Copies a pre-generated key pair of the algorithm of `kem`, or returns false when there is none.
+         */
+        bool take(OQS_KEM const* kem, uint8_t* publicKey, uint8_t* secretKey);
+
+        /**
+         * @brief Returns the hits and misses of every algorithm used since the start.
+         */
+        std::vector<Statistics> getStatistics() const;
+    };
+} // namespace lily::crypto
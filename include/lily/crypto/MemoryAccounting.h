@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+
+#include <lily/core/ErrorCode.h>
+
+namespace lily::crypto
+{
+    /**
+     * @brief The heap used by OpenSSL and the oqs-provider (through `OPENSSL_malloc`) while an account was active.
+     *
+     * The keys and buffers of the provider are allocated there. liboqs itself allocates with plain `malloc`, and its
+     * scratch memory is mostly on the stack, so neither is counted.
+     */
+    struct MemoryUsage
+    {
+        // The bytes requested by every allocation, including the new size of every reallocation
+        uint64_t allocatedBytes {};
+
+        // The highest amount of bytes still allocated at once, counted from the start of the account
+        uint64_t peakBytes {};
+        uint64_t allocations {};
+    };
+
+    /**
+     * @brief Replace the allocator of OpenSSL by one accounting every allocation to the active `MemoryAccount`.
+     *
+     * OpenSSL only accepts a new allocator before its first allocation, so it must be called at the very start of
+     * `main`, before `loadOQSProvider()`. The memory is still allocated by `malloc`, whose thread caches already keep
+     * the concurrent handshakes from contending, behind a small header holding the size of the allocation.
+     */
+    core::Expect<void> enableMemoryAccounting();
+
+    /**
+     * @brief The heap used by a single connection, accumulated from the thread running it.
+     *
+     * The allocator accumulates the allocations of a thread in thread-local counters, which are flushed to the account
+     * that owns the thread whenever `update()` is called. A handshake calls `begin()` right before it starts and
+     * `update()` on every record and message it sends or receives (the message callback of OpenSSL). When a step runs
+     * on a thread owned by another connection, the allocations made there before its first message are dropped, as
+     * they cannot be attributed. Every allocation is tagged with its account, so the memory released by the other
+     * connections running on the same thread (such as their `SSL_free`) is never taken off the account.
+     */
+    class MemoryAccount
+    {
+    private:
+        // Unique per handshake, so an allocation is never mistaken for one of a destroyed account
+        uint64_t id {};
+        MemoryUsage usage {};
+        int64_t liveBytes {};
+
+    public:
+        // Reset the account and make it the owner of the calling thread
+        void begin();
+
+        // Flush the allocations of the calling thread to the account, taking the thread over if needed
+        void update();
+
+        MemoryUsage const& getUsage() const
+        {
+            return this->usage;
+        }
+    };
+} // namespace lily::crypto
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+#include <lily/core/ErrorCode.h>
+
+namespace lily::crypto
+{
+    /**
+     * @brief The descriptor requests of the oqs-provider since the cache was built.
+     */
+    struct OQSDescriptorCounts
+    {
+        // The `OQS_KEM_new` and `OQS_SIG_new` calls served by the cache
+        uint64_t cached {};
+
+        // The calls that allocated a new descriptor, for an algorithm missing from the cache
+        uint64_t allocated {};
+    };
+
+    /**
+     * @brief Build the descriptor of every KEM and signature algorithm enabled in liboqs once.
+     *
+     * The oqs-provider creates a new descriptor with `OQS_KEM_new` or `OQS_SIG_new` for every key, which looks the
+     * algorithm up by name among all of liboqs and allocates it, then frees it with the key. Once the cache is built,
+     * these calls are redirected at link time (`-Wl,--wrap`) to the cached descriptors, which are never modified nor
+     * freed. It must be called once, after `loadOQSProvider()` and before any handshake.
+     */
+    core::Expect<void> buildOQSDescriptorCache();
+
+    // Returns the descriptor requests served by the cache and the ones that allocated
+    OQSDescriptorCounts getOQSDescriptorCounts();
+} // namespace lily::crypto
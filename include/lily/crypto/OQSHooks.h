@@ -0,0 +1,38 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace lily::crypto
+{
+    /**
+     * @brief The liboqs primitives that can be timed.
+     */
+    enum class OQSOperation : uint8_t
+    {
+        KEM_KEYPAIR,
+        KEM_ENCAPS,
+        KEM_DECAPS,
+        SIG_SIGN,
+        SIG_VERIFY,
+    };
+
+    /**
+     * @brief Receives the duration of a single liboqs primitive call.
+     *
+     * The hook runs on the thread that called the primitive, right after it returns, so it must be cheap. The
+     * algorithm name is owned by liboqs and stays valid for the whole process.
+     */
+    using OQSTimingHook = void (*)(OQSOperation operation, char const* algorithm, std::chrono::nanoseconds duration);
+
+    /**
+     * @brief Install the hook timing the liboqs primitives, or remove it with `nullptr`.
+     *
+     * The primitives are wrapped at link time (`-Wl,--wrap`), so liboqs itself is left untouched. Without a hook, a
+     * wrapped call only costs a single atomic load.
+     */
+    void setOQSTimingHook(OQSTimingHook hook);
+
+    // Returns the name of a liboqs primitive, as written to the logs
+    char const* getOQSOperationName(OQSOperation operation);
+} // namespace lily::crypto
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fmt/format.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stop_token>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace lily::log
+{
+    /**
+     * @brief What a thread does when its log buffer is full.
+     */
+    enum class OverflowPolicy
+    {
+        // Discard the record and count it
+        DROP,
+
+        // Wait until the writer thread frees some space
+        BLOCK,
+    };
+
+    /**
+     * @brief The configuration of the buffered logs.
+     */
+    struct BufferedLogConfig
+    {
+        // How often the writer thread formats the buffered records and writes them to the file
+        std::chrono::milliseconds flushInterval {100};
+
+        // What a thread does when its log buffer is full
+        OverflowPolicy overflow {OverflowPolicy::DROP};
+
+        // The number of records each thread can buffer between two flushes. Every thread writing to a log holds a
+        // buffer of its own, so it is kept small for the boards with little memory.
+        uint32_t bufferRecords {1024};
+    };
+
+    /**
+     * @brief Writes fixed-size records to a file from a background thread.
+     *
+     * Every thread appends its records to its own single-producer ring buffer, so writing a record never takes a lock
+     * and never formats anything. The writer thread drains every ring at each flush interval, or as soon as a full ring
+     * asks for it with `OverflowPolicy::BLOCK`, formats the records and writes the whole batch at once. The ring of a
+     * thread is released once the thread exits and its last records are written, so threads can come and go. The
+     * remaining records are written when the log is destroyed, which must outlive the threads writing to it.
+     *
+     * @tparam Record A trivially copyable record.
+     */
+    template <typename Record>
+    class BufferedLog
+    {
+        static_assert(std::is_trivially_copyable_v<Record>, "A buffered record must be trivially copyable");
+
+    public:
+        // Append a formatted record to the batch
+        using Formatter = void (*)(fmt::memory_buffer& out, Record const& record);
+
+    private:
+        struct Ring
+        {
+            // Left uninitialized, so the memory of a ring is only touched once records are written to it
+            struct Slot
+            {
+                alignas(Record) std::byte bytes[sizeof(Record)];
+            };
+
+            std::size_t capacity;
+            std::unique_ptr<Slot[]> slots;
+            alignas(64) std::atomic_size_t head {};
+            alignas(64) std::atomic_size_t tail {};
+
+            // Set when the owning thread exits, the ring is freed once drained
+            std::atomic_bool released {};
+
+            explicit Ring(std::size_t capacity): capacity {capacity}, slots {new Slot[capacity]} {}
+        };
+
+        /**
+         * @brief The rings of a thread, by log. Releases them when the thread exits.
+         */
+        struct LocalRings
+        {
+            std::vector<std::pair<BufferedLog const*, Ring*>> rings {};
+
+            ~LocalRings()
+            {
+                for (auto [owner, ring]: this->rings)
+                    ring->released.store(true, std::memory_order_release);
+            }
+        };
+
+        std::ostream& stream;
+        Formatter formatter;
+        std::atomic<std::chrono::milliseconds::rep> flushIntervalMs {BufferedLogConfig {}.flushInterval.count()};
+        std::atomic<OverflowPolicy> overflow {BufferedLogConfig {}.overflow};
+        std::atomic_uint32_t bufferRecords {BufferedLogConfig {}.bufferRecords};
+        std::atomic_uint64_t totalDropped {};
+
+        // Guards the registration of new rings and wakes the writer thread early
+        std::mutex mtx;
+        std::condition_variable_any drainRequested;
+        std::atomic_bool drainPending {};
+        std::vector<std::unique_ptr<Ring>> rings;
+
+        // Declared last, so it stops and writes the remaining records before anything else is destroyed
+        std::jthread writer;
+
+        // Returns the ring of the calling thread, registering it on first use
+        Ring& localRing()
+        {
+            // A thread may write to more than one log, so the rings are looked up by their owner
+            thread_local LocalRings localRings {};
+            for (auto [owner, ring]: localRings.rings)
+                if (owner == this)
+                    return *ring;
+
+            std::lock_guard lock {this->mtx};
+            auto capacity {std::max<std::size_t>(this->bufferRecords.load(std::memory_order_relaxed), 1)};
+            auto& ring {this->rings.emplace_back(std::make_unique<Ring>(capacity))};
+            localRings.rings.emplace_back(this, ring.get());
+            return *ring;
+        }
+
+        // Format and write every buffered record
+        void drain()
+        {
+            fmt::memory_buffer batch {};
+            {
+                std::lock_guard lock {this->mtx};
+                for (auto& ring: this->rings)
+                {
+                    // Read the release first, so the last records of an exited thread are drained before it is freed
+                    auto released {ring->released.load(std::memory_order_acquire)};
+                    auto head {ring->head.load(std::memory_order_relaxed)};
+                    auto tail {ring->tail.load(std::memory_order_acquire)};
+                    for (auto i {head}; i != tail; ++i)
+                        this->formatter(batch, std::bit_cast<Record>(ring->slots[i % ring->capacity]));
+                    ring->head.store(tail, std::memory_order_release);
+                    if (released)
+                        ring.reset();
+                }
+                std::erase(this->rings, nullptr);
+            }
+            if (batch.size() == 0)
+                return;
+            this->stream.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+            this->stream.flush();
+        }
+
+        void runWriter(std::stop_token stopToken)
+        {
+            while (!stopToken.stop_requested())
+            {
+                {
+                    std::unique_lock lock {this->mtx};
+                    this->drainRequested.wait_for(lock, stopToken,
+                                                  std::chrono::milliseconds {this->flushIntervalMs.load()},
+                                                  [this] { return this->drainPending.load(); });
+                    this->drainPending.store(false);
+                }
+                this->drain();
+            }
+            this->drain();
+        }
+
+    public:
+        BufferedLog(std::ostream& stream, Formatter formatter):
+            stream {stream}, formatter {formatter}, writer {std::bind_front(&BufferedLog::runWriter, this)}
+        {
+        }
+
+        BufferedLog(BufferedLog const&)            = delete;
+        BufferedLog(BufferedLog&&)                 = delete;
+        BufferedLog& operator=(BufferedLog const&) = delete;
+        BufferedLog& operator=(BufferedLog&&)      = delete;
+
+        // Change the flush interval and the overflow policy. The buffer size applies to the threads writing afterwards.
+        void configure(BufferedLogConfig const& config)
+        {
+            this->flushIntervalMs.store(config.flushInterval.count());
+            this->overflow.store(config.overflow);
+            this->bufferRecords.store(config.bufferRecords);
+        }
+
+        /**
+         * @brief Append a record to the ring of the calling thread.
+         *
+         * @return `false` when the ring is full and the record is dropped.
+         */
+        bool write(Record const& record)
+        {
+            auto& ring {this->localRing()};
+            auto tail {ring.tail.load(std::memory_order_relaxed)};
+            while (tail - ring.head.load(std::memory_order_acquire) == ring.capacity)
+            {
+                if (this->overflow.load(std::memory_order_relaxed) == OverflowPolicy::DROP)
+                {
+                    this->totalDropped.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+
+                // Ask the writer thread to drain now instead of waiting for the flush interval. The request is set
+                // under the lock, so it cannot be missed by a writer about to wait.
+                {
+                    std::lock_guard lock {this->mtx};
+                    this->drainPending.store(true);
+                }
+                this->drainRequested.notify_one();
+                std::this_thread::yield();
+            }
+            ring.slots[tail % ring.capacity] = std::bit_cast<typename Ring::Slot>(record);
+            ring.tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Returns the number of records dropped because a ring was full
+        uint64_t getDropped() const
+        {
+            return this->totalDropped.load(std::memory_order_relaxed);
+        }
+    };
+} // namespace lily::log
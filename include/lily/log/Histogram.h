@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace lily::log
+{
+    /**
+     * @brief A log-linear latency histogram in the style of HdrHistogram.
+     *
+     * The values are counted in buckets whose width doubles every power of two, with 64 buckets per power of two.
+     * Every recorded value is kept with a relative error below 1.6%, from 1 µs up to about 12 days, in a fixed
+     * amount of memory.
+     */
+    class Histogram
+    {
+    public:
+        static constexpr std::size_t SUB_BUCKET_BITS {7};
+        static constexpr std::size_t SUB_BUCKET_HALF_COUNT {std::size_t {1} << (SUB_BUCKET_BITS - 1)};
+        static constexpr std::size_t MAX_VALUE_BITS {40};
+        static constexpr std::size_t BUCKET_COUNT {(MAX_VALUE_BITS - SUB_BUCKET_BITS + 2) * SUB_BUCKET_HALF_COUNT};
+        static constexpr uint64_t MAX_VALUE {(uint64_t {1} << MAX_VALUE_BITS) - 1};
+
+    private:
+        std::array<uint64_t, BUCKET_COUNT> counts {};
+        uint64_t totalCount {};
+
+    public:
+        /**
+         * @brief Returns the bucket counting the given value. Values above `MAX_VALUE` are clamped.
+         */
+        static std::size_t bucketOf(uint64_t value);
+
+        /**
+         * @brief Returns the highest value counted by the given bucket.
+         */
+        static uint64_t highestValueOf(std::size_t bucket);
+
+        // Count a value, or add a number of values directly to a bucket
+        void record(uint64_t value, uint64_t count = 1);
+        void add(std::size_t bucket, uint64_t count);
+
+        // Add or remove the counts of another histogram, bucket by bucket
+        Histogram& operator+=(Histogram const& other);
+        Histogram& operator-=(Histogram const& other);
+
+        /**
+         * @brief Returns the value below which the given percentage (0 to 100) of the recorded values fall.
+         */
+        uint64_t percentile(double percentage) const;
+
+        // Returns the highest recorded value, or zero when empty
+        uint64_t max() const;
+
+        // Returns the number of recorded values
+        uint64_t count() const
+        {
+            return this->totalCount;
+        }
+
+        // Returns the number of values in a single bucket
+        uint64_t countAt(std::size_t bucket) const
+        {
+            return this->counts[bucket];
+        }
+    };
+} // namespace lily::log
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include <lily/log/Histogram.h>
+
+namespace lily::log
+{
+    /**
+     * @brief Records the latencies of every request into per-thread histograms.
+     *
+     * Every thread records into its own shard of atomic counters, so recording never takes a lock and never
+     * contends with the other threads. The shards are only merged when a snapshot is taken. The counts are
+     * cumulative, so the shard of an exited thread is kept and handed over to the next new thread.
+     */
+    class LatencyRecorder
+    {
+    public:
+        /**
+         * @brief The measured steps of a request.
+         */
+        enum class Metric : std::size_t
+        {
+            HANDSHAKE,
+            WRITE,
+            READ,
+            TOTAL,
+        };
+        static constexpr std::size_t METRIC_COUNT {4};
+        static constexpr std::array<std::string_view, METRIC_COUNT> METRIC_NAMES {"handshake", "write", "read",
+                                                                                  "total"};
+
+        using Snapshot = std::array<Histogram, METRIC_COUNT>;
+
+    private:
+        struct Shard
+        {
+            std::array<std::array<std::atomic_uint64_t, Histogram::BUCKET_COUNT>, METRIC_COUNT> counts {};
+
+            // Set when the recording thread exits, the shard is then free for another thread
+            std::atomic_bool released {};
+        };
+
+        /**
+         * @brief The shards of a thread, by recorder. Releases them when the thread exits.
+         */
+        struct LocalShards
+        {
+            std::vector<std::pair<LatencyRecorder const*, Shard*>> shards {};
+
+            ~LocalShards();
+        };
+
+        // Only guards the registration of new shards and the last snapshot
+        mutable std::mutex mtx;
+        std::vector<std::unique_ptr<Shard>> shards;
+        std::unique_ptr<Snapshot> lastSnapshot {std::make_unique<Snapshot>()};
+
+        // Returns the shard of the calling thread, taking a released one or registering a new one on first use
+        Shard& localShard();
+
+    public:
+        LatencyRecorder() = default;
+
+        LatencyRecorder(LatencyRecorder const&)            = delete;
+        LatencyRecorder(LatencyRecorder&&)                 = delete;
+        LatencyRecorder& operator=(LatencyRecorder const&) = delete;
+        LatencyRecorder& operator=(LatencyRecorder&&)      = delete;
+
+        // Record a single latency, in µs
+        void record(Metric metric, int64_t latencyUs);
+
+        /**
+         * @brief Returns the merged histograms of every value recorded since the start.
+         */
+        std::unique_ptr<Snapshot> snapshot() const;
+
+        /**
+         * @brief Returns the merged histograms of the values recorded since the last call.
+         */
+        std::unique_ptr<Snapshot> collect();
+
+        /**
+         * @brief Print the percentiles of every non-empty histogram of a snapshot, one line per metric.
+         */
+        static void print(Snapshot const& snapshot);
+
+        /**
+         * @brief Write the non-empty buckets of every histogram of a snapshot to a compact CSV file.
+         */
+        static void dump(Snapshot const& snapshot, std::filesystem::path const& path);
+    };
+} // namespace lily::log
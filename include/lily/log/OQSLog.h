@@ -0,0 +1,61 @@
+#pragma once
+
+#include <fstream>
+
+#include <lily/log/BufferedLog.h>
+
+namespace lily::log
+{
+    /**
+     * @brief A class to record and log the duration of the liboqs primitives called during the TLS handshakes.
+     */
+    class OQSLog
+    {
+    public:
+        /**
+         * @brief A single row of the liboqs log, recorded once per primitive call.
+         */
+        struct Record
+        {
+            // Both names are static strings, so the record stays fixed-size
+            char const* operation {};
+            char const* algorithm {};
+            int64_t durationNs {};
+        };
+
+    private:
+        std::ofstream stream;
+        BufferedLog<Record> buffer {this->stream, &OQSLog::format};
+
+        OQSLog();
+
+        OQSLog(OQSLog const&)            = delete;
+        OQSLog(OQSLog&&)                 = delete;
+        OQSLog& operator=(OQSLog const&) = delete;
+        OQSLog& operator=(OQSLog&&)      = delete;
+
+        // Format a single record as a CSV row
+        static void format(fmt::memory_buffer& out, Record const& record);
+
+    public:
+        static OQSLog& getInstance();
+
+        // Change the flush interval, the overflow policy and the size of the log buffer
+        void configure(BufferedLogConfig const& config)
+        {
+            this->buffer.configure(config);
+        }
+
+        // Buffer a single record for the writer thread
+        void write(Record const& record)
+        {
+            this->buffer.write(record);
+        }
+
+        // Returns the number of records dropped because the log buffer was full
+        uint64_t getDroppedRecords() const
+        {
+            return this->buffer.getDropped();
+        }
+    };
+} // namespace lily::log
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <fmt/format.h>
+#include <string_view>
+
+namespace lily::log
+{
+    /**
+     * @brief The hardware events counted by `perf_event_open`, in user space only.
+     */
+    enum class PerfEvent : std::size_t
+    {
+        CYCLES,
+        INSTRUCTIONS,
+        CACHE_MISSES,
+        BRANCH_MISSES,
+    };
+    static constexpr std::size_t PERF_EVENT_COUNT {4};
+    static constexpr std::array<std::string_view, PERF_EVENT_COUNT> PERF_EVENT_NAMES {"cycles", "instructions",
+                                                                                      "cache_misses", "branch_misses"};
+
+    using PerfCounts = std::array<uint64_t, PERF_EVENT_COUNT>;
+
+    /**
+     * @brief The steps of a connection the events are counted for.
+     */
+    enum class PerfSection : std::size_t
+    {
+        HANDSHAKE,
+        READ,
+        WRITE,
+    };
+    static constexpr std::size_t PERF_SECTION_COUNT {3};
+
+    /**
+     * @brief Open the hardware counters of every thread on its first use, and check that they can be opened at all.
+     *
+     * Returns false, after logging a warning, when the kernel does not permit them (`kernel.perf_event_paranoid`
+     * above 2 or a seccomp filter) or the machine has no PMU, as in most virtual machines. Nothing is counted then
+     * and every count stays zero. An event missing from the PMU is counted as zero, the others are still counted.
+     */
+    bool enablePerfCounters();
+
+    // Append the counts to a CSV row, each followed by the separator
+    void formatPerfCounts(fmt::memory_buffer& out, PerfCounts const& counts);
+
+    /**
+     * @brief The hardware events spent by a single connection, per step, accumulated from the threads running it.
+     *
+     * The counters are per thread and only count while the thread runs, so a connection sharing its thread with
+     * others must tell its own events apart. `update()` adds the events counted on the calling thread since the last
+     * update of the same account on that thread, and is called on every TLS record (the message callback of
+     * OpenSSL) and at the end of every step. When another connection updated the thread in between, the events are
+     * dropped instead, as they cannot be attributed. The events are dropped as well when the PMU did not schedule the
+     * counters at all since the last update, and scaled up to the elapsed time when it only scheduled them partly.
+     */
+    class PerfAccount
+    {
+    private:
+        // Unique per connection, so a thread is never mistaken as owned by a destroyed account
+        uint64_t id {};
+        std::array<PerfCounts, PERF_SECTION_COUNT> sections {};
+
+    public:
+        // Reset every step and make the account the owner of the calling thread
+        void begin();
+
+        // Reset the events of a step, such as the read and write of the previous request of a kept connection
+        void reset(PerfSection section);
+
+        // Add the events counted on the calling thread since the last update to a step, taking the thread over
+        void update(PerfSection section);
+
+        PerfCounts const& getCounts(PerfSection section) const
+        {
+            return this->sections[static_cast<std::size_t>(section)];
+        }
+    };
+} // namespace lily::log
@@ -1,7 +1,10 @@
 #pragma once
 
 #include <fstream>
-#include <mutex>
+
+#include <lily/log/BufferedLog.h>
+#include <lily/log/LatencyRecorder.h>
+#include <lily/log/PerfCounters.h>
 
 namespace lily::log
 {
@@ -10,9 +13,53 @@ namespace lily::log
      */
     class ServerLog
     {
+    public:
+        /**
+         * @brief A single row of the server log, recorded once per request.
+         */
+        struct Record
+        {
+            uint64_t connId {};
+
+            // The handshake duration, or -1 for the following requests of a kept-alive connection
+            int64_t hsDurationUs {};
+            uint64_t recvSize {};
+            int64_t recvDurationUs {};
+            uint64_t writeSize {};
+            int64_t writeDurationUs {};
+            bool resumed {};
+
+            // The handshake on the wire, and the TCP state when it finished
+            uint64_t hsBytesSent {};
+            uint64_t hsBytesRecv {};
+            uint64_t hsRecordsSent {};
+            uint64_t hsRecordsRecv {};
+            uint64_t hsFlights {};
+            uint32_t rttUs {};
+            uint32_t retransmits {};
+
+            // The heap allocated by OpenSSL and the oqs-provider in the handshake, zero without `--memory-accounting`
+            uint64_t hsMemBytes {};
+            uint64_t hsMemPeak {};
+            uint64_t hsMemAllocs {};
+
+            // The hardware events spent in the handshake, the read and the write, zero without `--perf-counters`
+            PerfCounts hsPerf {};
+            PerfCounts recvPerf {};
+            PerfCounts writePerf {};
+
+            // Whether the kernel encrypted the records sent and decrypted the records received (kTLS)
+            bool ktlsSend {};
+            bool ktlsRecv {};
+        };
+
     private:
         std::ofstream stream;
-        std::mutex mtx;
+        LatencyRecorder latency;
+        BufferedLog<Record> buffer {this->stream, &ServerLog::format};
+
+        // Format a single record as a CSV row
+        static void format(fmt::memory_buffer& out, Record const& record);
 
         ServerLog();
 
@@ -24,7 +71,28 @@ namespace lily::log
     public:
         static ServerLog& getInstance();
 
-        // 
-        void write(int64_t hsDurationUs, uint64_t recvSize, int64_t recvDurationUs, uint64_t writeSize, int64_t writeDurationUs);
+        // Change the flush interval, the overflow policy and the size of the log buffer
+        void configure(BufferedLogConfig const& config)
+        {
+            this->buffer.configure(config);
+        }
+
+        // Buffer a single record for the writer thread, and record its latencies into the histograms
+        void write(Record const& record);
+
+        // Returns the number of records dropped because the log buffer was full
+        uint64_t getDroppedRecords() const
+        {
+            return this->buffer.getDropped();
+        }
+
+        // Returns the latency histograms of every record written so far
+        LatencyRecorder& getLatencyRecorder()
+        {
+            return this->latency;
+        }
+
+        // Write the latency histograms of the whole run next to the log, in a compact form
+        void dumpHistograms(LatencyRecorder::Snapshot const& snapshot);
     };
 } // namespace lily::log
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <fstream>
+
+#include <lily/log/BufferedLog.h>
+
+namespace lily::log
+{
+    /**
+     * @brief A class to record and log the time of every message of the traced TLS handshakes.
+     */
+    class TraceLog
+    {
+    public:
+        /**
+         * @brief A single row of the trace log, recorded once per handshake.
+         *
+         * Every message time is measured from the start of the handshake (in µs), or -1 when the message was not
+         * seen. The connection id matches the `conn_id` column of the server or client log.
+         */
+        struct Record
+        {
+            uint64_t connId {};
+            int64_t clientHelloUs {};
+            int64_t serverHelloUs {};
+            int64_t encryptedExtensionsUs {};
+            int64_t certificateUs {};
+            int64_t certificateVerifyUs {};
+            int64_t serverFinishedUs {};
+            int64_t clientFinishedUs {};
+        };
+
+    private:
+        std::ofstream stream;
+        BufferedLog<Record> buffer {this->stream, &TraceLog::format};
+
+        TraceLog();
+
+        TraceLog(TraceLog const&)            = delete;
+        TraceLog(TraceLog&&)                 = delete;
+        TraceLog& operator=(TraceLog const&) = delete;
+        TraceLog& operator=(TraceLog&&)      = delete;
+
+        // Format a single record as a CSV row
+        static void format(fmt::memory_buffer& out, Record const& record);
+
+    public:
+        static TraceLog& getInstance();
+
+        // Change the flush interval, the overflow policy and the size of the log buffer
+        void configure(BufferedLogConfig const& config)
+        {
+            this->buffer.configure(config);
+        }
+
+        // Buffer a single record for the writer thread
+        void write(Record const& record)
+        {
+            this->buffer.write(record);
+        }
+
+        // Returns the number of records dropped because the log buffer was full
+        uint64_t getDroppedRecords() const
+        {
+            return this->buffer.getDropped();
+        }
+    };
+} // namespace lily::log
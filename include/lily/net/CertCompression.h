@@ -0,0 +1,53 @@
+#pragma once
+
+#include <openssl/ssl.h>
+#include <string_view>
+#include <vector>
+
+#include <lily/core/ErrorCode.h>
+
+// The certificate compression API was added by OpenSSL 3.2
+#if OPENSSL_VERSION_NUMBER >= 0x30200000L and !defined(OPENSSL_NO_COMP_ALG)
+#define LILY_CERT_COMPRESSION 1
+#endif
+
+namespace lily::net
+{
+    /**
+     * @brief A certificate chain compressed once with a single algorithm (RFC 8879), served as is by every handshake.
+     */
+    struct CompressedCertificate
+    {
+        int algorithm {};
+        std::vector<unsigned char> data {};
+        std::size_t originalLength {};
+    };
+
+    /**
+     * @brief Parse the certificate compression algorithms, separated by colons in order of preference.
+     *
+     * The names are `zlib`, `brotli` and `zstd`. Fails when one is unknown or not supported by the linked OpenSSL,
+     * which needs version 3.2 or later built with the algorithm. An empty list disables the compression.
+     */
+    core::Expect<std::vector<int>> parseCertCompression(std::string_view algorithms);
+
+    /**
+     * @brief Offers and accepts the compressed certificates on a context, with the algorithms in order of preference.
+     *
+     * Without any algorithm, the compression is disabled both ways, so the handshakes stay comparable whatever the
+     * defaults of the linked OpenSSL are.
+     */
+    core::Expect<void> configureCertCompression(SSL_CTX* ctx, std::vector<int> const& algorithms);
+
+    /**
+     * @brief Compresses the certificate chain loaded in a context once with every algorithm.
+     *
+     * The context keeps the compressed chains and serves them to every handshake. The compressed and uncompressed
+     * sizes of the chain are printed for every algorithm. Nothing is compressed without any algorithm.
+     */
+    core::Expect<std::vector<CompressedCertificate>> compressCertificate(SSL_CTX* ctx,
+                                                                         std::vector<int> const& algorithms);
+
+    // Serve the compressed chains on a connection, after its certificate was replaced
+    bool useCompressedCertificate(SSL* ssl, std::vector<CompressedCertificate> const& certificates);
+} // namespace lily::net
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <openssl/ssl.h>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <lily/core/ErrorCode.h>
+#include <lily/net/CertCompression.h>
+
+namespace lily::net
+{
+    /**
+     * @brief The certificates served by a `ServerListener`, replaceable while it runs.
+     *
+     * The store is installed as the certificate callback of the server context, so every handshake takes the current
+     * credentials once the ClientHello is processed. Replacing them never affects a handshake in progress and never
+     * requires a restart. Until credentials are set, the certificate loaded in the context is served.
+     *
+     * When the store holds several credentials, every handshake selects the first one usable with the signature
+     * algorithms offered by the client, preferring the ones naming the server requested through SNI. A single
+     * process can then serve classical, hybrid and pure post-quantum clients.
+     *
+     * With certificate compression, every credentials are compressed once when parsed, and every handshake serving
+     * them copies the compressed chains instead of compressing again.
+     */
+    class CertificateStore
+    {
+    public:
+        /**
+         * @brief A certificate, the rest of its chain and its private key.
+         */
+        struct Credentials
+        {
+            X509* certificate {};
+            STACK_OF(X509) * chain {};
+            EVP_PKEY* privateKey {};
+
+            // The chain compressed with every algorithm of the store
+            std::vector<CompressedCertificate> compressed {};
+
+            Credentials() = default;
+            ~Credentials();
+
+            Credentials(Credentials const&)            = delete;
+            Credentials(Credentials&&)                 = delete;
+            Credentials& operator=(Credentials const&) = delete;
+            Credentials& operator=(Credentials&&)      = delete;
+        };
+
+        using CredentialsList = std::vector<std::shared_ptr<Credentials const>>;
+
+    private:
+        std::atomic<std::shared_ptr<CredentialsList const>> current {};
+
+        // The certificate compression algorithms, in order of preference
+        std::vector<int> compression;
+
+        // Select the credentials matching the client among the current ones, and serve them on a connection
+        static int onCertificate(SSL* ssl, void* arg);
+
+    public:
+        explicit CertificateStore(std::vector<int> compression = {}): compression {std::move(compression)} {}
+
+        CertificateStore(CertificateStore const&)            = delete;
+        CertificateStore(CertificateStore&&)                 = delete;
+        CertificateStore& operator=(CertificateStore const&) = delete;
+        CertificateStore& operator=(CertificateStore&&)      = delete;
+
+        /**
+         * @brief Parse a PEM certificate chain, leaf first, together with its PEM private key.
+         *
+         * The blocks may come in any order, the private key is told apart by its PEM label. Fails when the private
+         * key does not match the certificate, or when the chain cannot be compressed.
+         */
+        core::Expect<std::shared_ptr<Credentials const>> parse(std::string_view pem) const;
+
+        // Load a PEM certificate chain and its PEM private key from their files
+        core::Expect<std::shared_ptr<Credentials const>> load(std::filesystem::path const& certificatePath,
+                                                              std::filesystem::path const& privateKeyPath) const;
+
+        // Install the certificate callback on a server context. The store must outlive the context.
+        void install(SSL_CTX* ctx);
+
+        // Select among the given credentials, in order of preference, on every following handshake
+        void replace(CredentialsList credentials)
+        {
+            this->current.store(std::make_shared<CredentialsList const>(std::move(credentials)));
+        }
+    };
+} // namespace lily::net
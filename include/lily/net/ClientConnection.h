@@ -1,27 +1,218 @@
 #pragma once
 
+#include <array>
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 #include <boost/beast.hpp>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include <lily/core/ErrorCode.h>
+#include <lily/net/ClientSessionStore.h>
+#include <lily/net/HandshakeTrace.h>
+#include <lily/net/SocketOptions.h>
+#include <lily/net/TlsStream.h>
 
 namespace lily::net
 {
+    /**
+     * @brief The configuration of the requests sent by a client user.
+     */
+    struct ClientConfig
+    {
+        // The server host address and port
+        std::string serverHost {};
+        uint16_t serverPort {};
+
+        // The TLS group used for the key exchange
+        std::string tlsGroup {};
+
+        // The size of the dummy body sent with every request (in bytes). It is streamed, so it may exceed the memory.
+        uint64_t dummyDataLength {};
+
+        // The fraction of requests resuming the previous TLS session of the user
+        double resumptionRatio {};
+
+        // Whether the time of every handshake message is written to the trace log
+        bool traceHandshake {};
+
+        // The certificate compression algorithms accepted from the server, separated by colons in order of
+        // preference, among `zlib`, `brotli` and `zstd`. Empty disables it.
+        std::string certCompression {};
+
+        // Whether every user keeps its connection open and sends all its requests over it, so the record layer is
+        // measured rather than the handshake
+        bool keepAlive {};
+
+        // The TLS 1.3 cipher suites offered, separated by colons, such as `TLS_CHACHA20_POLY1305_SHA256`. Empty offers
+        // the defaults of OpenSSL.
+        std::string cipherSuites {};
+
+        // The largest plaintext carried by a record sent, between 512 and 16384 bytes. Zero keeps 16384.
+        uint32_t maxRecordSize {};
+
+        // Whether the records of every connection are encrypted and decrypted by the kernel once the handshake
+        // completes (kTLS). A connection the kernel cannot offload falls back to the records encrypted by OpenSSL.
+        bool ktls {};
+
+        // The TCP options of every connection. Fast Open sends the ClientHello with the SYN once the server granted a
+        // cookie.
+        SocketOptions socketOptions {};
+
+        // The local addresses the connections are bound to in turn, each with its own range of ephemeral ports. Empty
+        // lets the kernel pick the address, which limits the connections open at once to a single port range.
+        std::vector<std::string> sourceAddresses {};
+    };
+
+    /**
+     * @brief The step a request failed at, counted by the load generator.
+     */
+    enum class FailureCause : std::size_t
+    {
+        CONNECTION_REFUSED,
+        NO_LOCAL_PORT,
+        CONNECT,
+        CONNECTION_RESET,
+        HANDSHAKE,
+        WRITE,
+        READ,
+        SHUTDOWN,
+    };
+    static constexpr std::size_t FAILURE_CAUSE_COUNT {8};
+    static constexpr std::array<std::string_view, FAILURE_CAUSE_COUNT> FAILURE_CAUSE_NAMES {
+        "refused", "no local port", "connect", "reset", "handshake", "write", "read", "shutdown"};
+
+    /**
+     * @brief The measurements of a single request returned to its user.
+     */
+    struct RequestResult
+    {
+        // The handshake of the request, when it opened a new connection
+        std::optional<HandshakeTrace::Accounting> handshake {};
+
+        // The HTTP bytes of the request and of its echo
+        uint64_t bytesSent {};
+        uint64_t bytesReceived {};
+
+        // The name of the negotiated cipher suite, owned by OpenSSL
+        char const* cipherSuite {};
+    };
+
+    /**
+     * @brief A TLS connection kept open by a user between its requests.
+     *
+     * The handshake trace lives as long as the connection, as OpenSSL keeps passing it every record.
+     */
+    struct KeptConnection
+    {
+        std::unique_ptr<TlsStream> stream {};
+        HandshakeTrace trace {};
+        uint64_t connectionId {};
+    };
+
+    /**
+     * @brief A long-lived client engine shared by every request of a run.
+     *
+     * The SSL context is configured, the server address is resolved and the request is serialized once, when the
+     * engine is created. Every request then reuses them, so the measured duration only covers the TLS connection
+     * itself. The dummy body is streamed from a single shared chunk and the echoed body is read chunk by chunk, so the
+     * memory of a request does not grow with its size.
+     */
     class ClientConnection
     {
     private:
-        std::unique_ptr<boost::beast::net::io_context> ioc;
+        ClientConfig config;
         boost::asio::ssl::context ctx;
+        boost::asio::ip::tcp::resolver::results_type resolvedServer;
+        std::vector<boost::asio::ip::address> sourceAddresses {};
+
+        // Whether the server host is a name sent through SNI, rather than an IP address
+        bool sendServerName {};
+
+        // The serialized request header followed by the first chunk of the dummy body, shared by every request. The
+        // rest of the body repeats the chunk.
+        std::string serializedRequest {};
+        std::size_t requestHeaderSize {};
+
+        // The one-time cost of the set-up that is no longer paid by every request
+        std::chrono::microseconds contextSetupDuration {};
+        std::chrono::microseconds resolveDuration {};
 
-        ClientConnection();
+        ClientConnection(ClientConfig const& config);
+
+        // Open the socket of a connection to a server endpoint with the TCP options, bound to the next source address
+        // of the same family, if any
+        core::Expect<void> openSocket(boost::asio::ip::tcp::socket& socket,
+                                      boost::asio::ip::tcp::endpoint const& endpoint) const;
+
+        // Open a new connection and perform the handshake, returns its duration in µs
+        boost::asio::awaitable<core::Expect<int64_t>> handshake(KeptConnection& connection,
+                                                                ClientSessionStore& sessionStore,
+                                                                FailureCause& failure);
+
+        // Write the rest of the dummy body after the shared request, repeating its chunk
+        boost::asio::awaitable<void> writeBody(TlsStream& stream, uint64_t remaining, std::size_t& writeSize,
+                                               boost::beast::error_code& ec) const;
         ClientConnection(ClientConnection const&)            = delete;
         ClientConnection& operator=(ClientConnection const&) = delete;
 
     public:
         ClientConnection(ClientConnection&& other);
         ClientConnection& operator=(ClientConnection&& other);
-        static core::Expect<void> sendDummyData(std::string const& serverHost, uint16_t serverPort,
-                                                std::string const& tlsGroup, uint32_t dummyDataLength);
+
+        /**
+         * @brief Constructs a new `ClientConnection` instance, configuring the SSL context and resolving the server.
+         */
+        static core::Expect<ClientConnection> create(ClientConfig const& config);
+
+        /**
+         * @brief Configures a client SSL context the same way as the engine, offering only the configured TLS group.
+         */
+        static core::Expect<void> configureContext(boost::asio::ssl::context& ctx, ClientConfig const& config);
+
+        /**
+         * @brief Sends a single dummy request over a new TLS connection and logs its measurements.
+         *
+         * The request runs as a coroutine on the executor of the calling coroutine, so many users can be multiplexed
+         * over the same thread. The engine is only read, so it can be shared by the coroutines of every thread.
+         *
+         * @param intendedStart The time the request was scheduled to start. The latency is measured from it, so a
+         *                      request that starts late is not hidden. Defaults to the actual start.
+         * @param kept The connection kept open between the requests of the user, in the keep-alive mode. The request
+         *             reuses it, or opens it when it is closed. A request that fails closes it.
+         * @param failure Receives the step the request failed at, if it fails.
+         * @return The bytes of the request and the bytes, records and flights of its handshake, if any.
+         */
+        boost::asio::awaitable<core::Expect<RequestResult>> sendDummyData(
+            ClientSessionStore& sessionStore, std::optional<std::chrono::steady_clock::time_point> intendedStart = {},
+            KeptConnection* kept = nullptr, FailureCause* failure = nullptr);
+
+        /**
+         * @brief Sends a single control request to the server over a new TLS connection, blocking until it responds.
+         *
+         * The request is not measured. It fails when the server does not respond with `200 OK`, such as when the
+         * control is not enabled on the server.
+         */
+        core::Expect<void> sendControl(char const* target, std::string const& body);
+
+        /**
+         * @brief Returns how long configuring the SSL context took.
+         */
+        std::chrono::microseconds getContextSetupDuration() const
+        {
+            return this->contextSetupDuration;
+        }
+
+        /**
+         * @brief Returns how long resolving the server address took.
+         */
+        std::chrono::microseconds getResolveDuration() const
+        {
+            return this->resolveDuration;
+        }
     };
 } // namespace lily::net
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+#include <openssl/ssl.h>
+#include <random>
+
+namespace lily::net
+{
+    /**
+     * @brief Keeps the last TLS session of a single client user, so the next request can resume it.
+     *
+     * Each user owns its store. Whether a request offers the stored session ticket or performs a full handshake is
+     * drawn from the configured resumption ratio.
+     */
+    class ClientSessionStore
+    {
+    private:
+        std::unique_ptr<SSL_SESSION, decltype(&SSL_SESSION_free)> session {nullptr, SSL_SESSION_free};
+        std::bernoulli_distribution resumeDistribution;
+        std::minstd_rand generator;
+        bool lastResumed {};
+
+    public:
+        /**
+         * @brief Constructs a new `ClientSessionStore` instance.
+         *
+         * @param resumptionRatio The fraction of requests, between 0 and 1, that offer the stored session.
+         */
+        explicit ClientSessionStore(double resumptionRatio);
+
+        /**
+         * @brief Attach the stored session to the connection if this request should be resumed.
+         */
+        void offer(SSL* ssl);
+
+        /**
+         * @brief Keep the session of a completed connection for the next requests.
+         *
+         * The session is only kept when it carries a resumable ticket, which the server sends after the handshake.
+         */
+        void update(SSL* ssl);
+
+        /**
+         * @brief Returns whether the last completed connection was resumed from the stored session.
+         */
+        bool wasResumed() const
+        {
+            return this->lastResumed;
+        }
+    };
+} // namespace lily::net
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <boost/asio.hpp>
+#include <chrono>
+
+namespace lily::net
+{
+    /**
+     * @brief A bounded pool of threads that runs the CPU-heavy steps of the TLS handshakes.
+     *
+     * The handshake of a `ServerSession` is bound to the executor of this pool. Every step of the handshake, including
+     * the certificate signing and the key encapsulation, then runs on the pool while the I/O threads keep servicing the
+     * other sockets. The pool also measures how long each step waits in its queue.
+     */
+    class CryptoPool
+    {
+    public:
+        /**
+         * @brief An executor that submits the work to the `CryptoPool` and records the queueing metrics.
+         */
+        class Executor
+        {
+        private:
+            CryptoPool* pool;
+
+        public:
+            explicit Executor(CryptoPool* pool) noexcept: pool {pool} {}
+
+            template<typename Function>
+            void execute(Function&& function) const
+            {
+                this->pool->queueDepth.fetch_add(1, std::memory_order_relaxed);
+                this->pool->threads.get_executor().execute(
+                    [pool = this->pool, enqueueTime = std::chrono::steady_clock::now(),
+                     function = std::forward<Function>(function)]() mutable
+                    {
+                        pool->onDequeue(enqueueTime);
+                        std::move(function)();
+                    });
+            }
+
+            boost::asio::execution_context& query(boost::asio::execution::context_t) const noexcept
+            {
+                return this->pool->threads;
+            }
+
+            friend bool operator==(Executor const& lhs, Executor const& rhs) noexcept
+            {
+                return lhs.pool == rhs.pool;
+            }
+
+            friend bool operator!=(Executor const& lhs, Executor const& rhs) noexcept
+            {
+                return lhs.pool != rhs.pool;
+            }
+        };
+
+        /**
+         * @brief The metrics of the pool queue since the previous snapshot.
+         */
+        struct Metrics
+        {
+            int64_t queueDepth {};
+            uint64_t jobs {};
+            double averageWaitUs {};
+            double maxWaitUs {};
+        };
+
+    private:
+        boost::asio::thread_pool threads;
+        std::atomic_int64_t queueDepth {};
+        std::atomic_uint64_t totalJobs {};
+        std::atomic_uint64_t totalWaitNs {};
+        std::atomic_uint64_t maxWaitNs {};
+
+        // Snapshot of the counters at the previous `collect()` call
+        uint64_t lastJobs {};
+        uint64_t lastWaitNs {};
+
+        // Account a job leaving the queue and starting on a pool thread
+        void onDequeue(std::chrono::steady_clock::time_point enqueueTime);
+
+    public:
+        explicit CryptoPool(uint32_t threadCount);
+
+        CryptoPool(CryptoPool const&)            = delete;
+        CryptoPool(CryptoPool&&)                 = delete;
+        CryptoPool& operator=(CryptoPool const&) = delete;
+        CryptoPool& operator=(CryptoPool&&)      = delete;
+
+        Executor get_executor() noexcept
+        {
+            return Executor {this};
+        }
+
+        /**
+         * @brief Returns the queue metrics since the previous call. Must only be called from a single thread.
+         */
+        Metrics collect();
+    };
+} // namespace lily::net
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <openssl/ssl.h>
+
+#include <lily/crypto/MemoryAccounting.h>
+#include <lily/log/PerfCounters.h>
+
+namespace lily::net
+{
+    /**
+     * @brief Timestamps the TLS 1.3 handshake messages of a single connection, and accounts its bytes on the wire.
+     *
+     * The message callback installed on the SSL context is called by OpenSSL for every TLS record header and every
+     * handshake message sent or received. Each connection attaches its own `HandshakeTrace` as the callback argument.
+     * The time of the first occurrence of every message is kept relative to the start of the handshake, and the
+     * records are counted per direction until the handshake finishes. A flight is a run of consecutive records sent
+     * in the same direction. The heap allocated by OpenSSL for the handshake is accounted on every message too, when
+     * the memory accounting is enabled. The hardware performance counters are accounted on every record for the whole
+     * life of the connection, to the handshake and then to the read or the write of the record.
+     */
+    class HandshakeTrace
+    {
+    public:
+        /**
+         * @brief The traced handshake messages, in the order of a full handshake.
+         */
+        enum class Phase : uint8_t
+        {
+            CLIENT_HELLO,
+            SERVER_HELLO,
+            ENCRYPTED_EXTENSIONS,
+            CERTIFICATE,
+            CERTIFICATE_VERIFY,
+            SERVER_FINISHED,
+            CLIENT_FINISHED,
+        };
+        static constexpr std::size_t PHASE_COUNT {7};
+
+        // The time of a message that was never seen, such as the certificate of a resumed handshake
+        static constexpr int64_t PHASE_NOT_SEEN {-1};
+
+        /**
+         * @brief The bytes and records of the handshake on the wire, and the TCP state when it finished.
+         */
+        struct Accounting
+        {
+            // Every TLS record, including its 5 bytes header
+            uint64_t bytesSent {};
+            uint64_t bytesReceived {};
+            uint64_t recordsSent {};
+            uint64_t recordsReceived {};
+            uint64_t flights {};
+
+            // The smoothed round trip time (in µs) and the total retransmitted segments from `TCP_INFO`
+            uint32_t rttUs {};
+            uint32_t retransmits {};
+
+            // The heap allocated by OpenSSL and the oqs-provider in the handshake, zero without the memory accounting
+            uint64_t memBytes {};
+            uint64_t memPeak {};
+            uint64_t memAllocations {};
+        };
+
+    private:
+        std::chrono::steady_clock::time_point beginTime {};
+        std::array<int64_t, PHASE_COUNT> phaseUs {};
+        Accounting accounting {};
+        crypto::MemoryAccount memory {};
+        log::PerfAccount perf {};
+        int lastDirection {-1};
+        bool finished {};
+
+        static void onMessage(int writeP, int version, int contentType, void const* buf, size_t length, SSL* ssl,
+                              void* arg);
+
+    public:
+        /**
+         * @brief Install the message callback on an SSL context. Only the connections attached to a trace are seen.
+         */
+        static void install(SSL_CTX* ctx);
+
+        /**
+         * @brief Start tracing a connection. Must be called right before its handshake starts.
+         */
+        void attach(SSL* ssl);
+
+        /**
+         * @brief Stop the accounting once the handshake completed, and read the TCP state of its socket. Must be called
+         * from the thread completing the handshake.
+         */
+        void finish(int socket);
+
+        // Returns the bytes and records of the handshake on the wire
+        Accounting const& getAccounting() const
+        {
+            return this->accounting;
+        }
+
+        // Returns the hardware events of the connection, which are read and written by the connection at every step
+        log::PerfAccount& getPerf()
+        {
+            return this->perf;
+        }
+
+        /**
+         * @brief Returns the time of a message since the start of the handshake (in µs), or `PHASE_NOT_SEEN`.
+         */
+        int64_t getPhaseUs(Phase phase) const
+        {
+            return this->phaseUs[static_cast<std::size_t>(phase)];
+        }
+
+        // Append the message times to the `TraceLog`, keyed by the id of the connection
+        void write(uint64_t connectionId) const;
+    };
+} // namespace lily::net
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <lily/core/ErrorCode.h>
+#include <lily/log/LatencyRecorder.h>
+#include <lily/net/ClientConnection.h>
+
+namespace lily::net
+{
+    /**
+     * @brief The arrival process of the requests in the open-loop mode.
+     */
+    enum class ArrivalProcess
+    {
+        // The requests are evenly spaced
+        CONSTANT,
+
+        // The gaps between the requests are exponentially distributed around the mean
+        POISSON,
+    };
+
+    /**
+     * @brief The configuration used to create a `LoadGenerator`.
+     */
+    struct LoadConfig
+    {
+        // The requests sent by every user
+        ClientConfig client {};
+
+        // The number of virtual users sending requests concurrently
+        uint32_t concurrentUsers {};
+
+        // The number of threads the virtual users are multiplexed over
+        uint32_t clientThreads {};
+
+        // The offered load of the open-loop mode, in requests per second. Zero runs the users in a closed loop, each
+        // sending its next request as soon as the previous one completes.
+        double rate {};
+
+        // How the requests of the open-loop mode are spaced
+        ArrivalProcess arrival {ArrivalProcess::CONSTANT};
+
+        // How long the users run. Zero runs them until interrupted.
+        std::chrono::seconds duration {};
+
+        // The number of completed requests after which the users stop. Zero sends requests until the duration elapses.
+        uint64_t requestLimit {};
+    };
+
+    /**
+     * @brief The totals of a single `LoadGenerator` run.
+     */
+    struct LoadSummary
+    {
+        uint64_t successfulRequests {};
+        uint64_t failedRequests {};
+        uint64_t resumedRequests {};
+        uint64_t missedSlots {};
+
+        // The failed requests by the step they failed at
+        std::array<uint64_t, FAILURE_CAUSE_COUNT> failures {};
+
+        // The time the users were running
+        std::chrono::microseconds elapsed {};
+
+        // The handshakes of the successful requests, one per request unless the connections are kept alive
+        uint64_t handshakes {};
+
+        // The handshake bytes sent and received by the users over every successful request
+        uint64_t hsBytesSent {};
+        uint64_t hsBytesRecv {};
+
+        // The HTTP bytes sent and received by the users over every successful request
+        uint64_t bytesSent {};
+        uint64_t bytesRecv {};
+
+        // The CPU time used by the whole process while the users were running, both user and system
+        std::chrono::microseconds cpuTime {};
+
+        // The HTTP bytes sent and received by every user over the run, in MB/s
+        std::vector<double> userThroughput {};
+
+        // The number of successful requests by negotiated cipher suite
+        std::map<std::string, uint64_t> cipherSuites {};
+
+        // The latency histograms of the requests of this run only, in µs
+        std::unique_ptr<log::LatencyRecorder::Snapshot> latency {std::make_unique<log::LatencyRecorder::Snapshot>()};
+
+        // Whether the run was interrupted or terminated before its duration or request limit
+        bool interrupted {};
+    };
+
+    /**
+     * @brief Simulates many concurrent client users against the server.
+     *
+     * Every virtual user is a coroutine that sends requests back-to-back. The users are spread over a small pool of
+     * threads, each running its own `io_context`, so tens of thousands of users fit on a single machine.
+     *
+     * In the open-loop mode, the requests follow a fixed timetable instead, independent of the completions. The users
+     * only bound the number of requests in flight: a free user takes the next slot of the timetable of its thread and
+     * waits until it is due. When every user is busy, the slot is taken late and counted as missed, and its latency
+     * is still measured from the intended start.
+     *
+     * In the keep-alive mode, every user opens a single connection and sends all its requests over it, so the run
+     * measures the throughput of the record layer instead of the handshakes.
+     */
+    class LoadGenerator
+    {
+    private:
+        /**
+         * @brief The slots of the open-loop timetable of a single client thread.
+         *
+         * Only the users of the owning thread take slots, so it needs no synchronization.
+         */
+        struct Timetable
+        {
+            ArrivalProcess arrival;
+            std::chrono::duration<double> meanInterval;
+            std::chrono::steady_clock::time_point nextSlot {};
+            std::exponential_distribution<double> gapDistribution {1.0};
+            std::minstd_rand generator {std::random_device {}()};
+
+            Timetable(ArrivalProcess arrival, double rate): arrival {arrival}, meanInterval {1.0 / rate} {}
+
+            // Take the next slot and schedule the one after it. The first slot is the time it is taken.
+            std::chrono::steady_clock::time_point take();
+        };
+
+        /**
+         * @brief The traffic of a single virtual user, only touched by its own thread while running.
+         */
+        struct UserTraffic
+        {
+            uint64_t bytes {};
+
+            // The successful requests by cipher suite, keyed by the names owned by OpenSSL
+            std::map<char const*, uint64_t> cipherSuites {};
+        };
+
+        LoadConfig config;
+
+        // Record total request
+        std::atomic_int64_t totalSuccessfulRequest {};
+        std::atomic_int64_t totalFailedRequest {};
+        std::atomic_int64_t totalResumedRequest {};
+        std::atomic_int64_t totalMissedSlot {};
+        std::array<std::atomic_uint64_t, FAILURE_CAUSE_COUNT> totalFailures {};
+        std::atomic_uint64_t totalHandshakeBytesSent {};
+        std::atomic_uint64_t totalHandshakeBytesRecv {};
+        std::atomic_uint64_t totalHandshake {};
+        std::atomic_uint64_t totalBytesSent {};
+        std::atomic_uint64_t totalBytesRecv {};
+        std::atomic_bool interrupted {};
+
+        // Each thread runs its own `io_context`, so the users never need a strand
+        std::vector<std::unique_ptr<boost::asio::io_context>> contexts {};
+        std::vector<UserTraffic> userTraffic {};
+        LoadSummary summary {};
+
+        // The loop of a single virtual user. The timetable is only given in the open-loop mode.
+        boost::asio::awaitable<void> runUser(ClientConnection& connection, Timetable* timetable, UserTraffic& traffic);
+
+        // Stop every user, from any thread
+        void stop();
+
+        // Print the total requests and the latency percentiles of the last interval periodically
+        void printTotalRequest(std::stop_token stopToken);
+
+    public:
+        explicit LoadGenerator(LoadConfig const& config);
+
+        LoadGenerator(LoadGenerator const&)            = delete;
+        LoadGenerator(LoadGenerator&&)                 = delete;
+        LoadGenerator& operator=(LoadGenerator const&) = delete;
+        LoadGenerator& operator=(LoadGenerator&&)      = delete;
+
+        /**
+         * @brief Starts every virtual user and blocks the calling thread while they are testing the server.
+         *
+         * The users stop on interruption or termination, once the duration elapses or once the request limit is
+         * reached, whichever comes first. The totals of the run are then available from `getSummary()`.
+         *
+         * The client engine shared by every user is created first, and fails the run if it cannot be set up.
+         */
+        core::Expect<void> run();
+
+        /**
+         * @brief Print and dump the latency histograms of the last run.
+         */
+        void report() const;
+
+        /**
+         * @brief Returns the totals of the last run.
+         */
+        LoadSummary const& getSummary() const
+        {
+            return this->summary;
+        }
+    };
+} // namespace lily::net
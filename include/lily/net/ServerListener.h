@@ -1,14 +1,73 @@
 #pragma once
 
+#include <atomic>
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 #include <boost/beast.hpp>
+#include <chrono>
 #include <filesystem>
+#include <stop_token>
+#include <string>
+#include <vector>
 
 #include <lily/core/ErrorCode.h>
+#include <lily/net/CertificateStore.h>
+#include <lily/net/CryptoPool.h>
+#include <lily/net/SocketOptions.h>
 
 namespace lily::net
 {
+    /**
+     * @brief The configuration used to create a `ServerListener`.
+     */
+    struct ServerConfig
+    {
+        // The port number to listen on
+        uint16_t port {};
+
+        // The number of threads running the `io_context`, spread evenly across the shards
+        uint32_t workerThreads {};
+
+        // The number of acceptors opened on the same port with `SO_REUSEPORT`. Each shard gets its own `io_context`.
+        // A single shard shares one `io_context` among every worker thread.
+        uint32_t acceptorShards {1};
+
+        // The server's certificate chains and their private keys, in PEM format, paired in order. Every handshake
+        // serves the first certificate usable with the signature algorithms of the client.
+        std::vector<std::filesystem::path> certificatePaths {};
+        std::vector<std::filesystem::path> privateKeyPaths {};
+
+        // The number of TLS 1.3 session tickets issued after every full handshake. Zero disables the resumption.
+        uint32_t sessionTickets {2};
+
+        // The lifetime of the issued session tickets
+        std::chrono::seconds sessionTicketLifetime {7200};
+
+        // The number of threads running the TLS handshakes off the I/O threads. Zero runs them inline.
+        uint32_t cryptoThreads {};
+
+        // Whether the time of every handshake message is written to the trace log
+        bool traceHandshake {};
+
+        // Whether the clients may replace the served certificate with a `POST` to the control target, which lets a
+        // sweep measure every signature algorithm without restarting the server. Only enable it on a test bench.
+        bool enableControl {};
+
+        // The certificate compression algorithms offered to the clients, separated by colons in order of preference,
+        // among `zlib`, `brotli` and `zstd`. Every certificate is compressed once when loaded. Empty disables it.
+        std::string certCompression {};
+
+        // The largest plaintext carried by a record sent, between 512 and 16384 bytes. Zero keeps 16384.
+        uint32_t maxRecordSize {};
+
+        // Whether the records of every connection are encrypted and decrypted by the kernel once the handshake
+        // completes (kTLS). A connection the kernel cannot offload falls back to the records encrypted by OpenSSL.
+        bool ktls {};
+
+        // The TCP options of every accepted connection. Fast Open lets the listener accept the data sent with a SYN.
+        SocketOptions socketOptions {};
+    };
+
     /**
      * @brief Represents a network listener for handling incoming connections.
      *
@@ -18,28 +77,76 @@ namespace lily::net
      */
     class ServerListener
     {
-        std::unique_ptr<boost::beast::net::io_context> ioc;
+        /**
+         * @brief A single acceptor together with the `io_context` and threads that serve its connections.
+         *
+         * With `SO_REUSEPORT`, every shard owns its own accept queue and the kernel spreads the incoming
+         * connections across the shards.
+         */
+        struct AcceptorShard
+        {
+            std::unique_ptr<boost::beast::net::io_context> ioc;
+            boost::asio::ip::tcp::acceptor acceptor;
+
+            // Delays the next accept after a failed one, so a persistent error (such as `EMFILE`) does not spin
+            boost::asio::steady_timer retryTimer;
+            uint32_t threads;
+            std::atomic_uint64_t totalAccepted {};
+
+            AcceptorShard(uint32_t threads):
+                ioc {std::make_unique<boost::beast::net::io_context>(static_cast<int>(threads))},
+                acceptor {*ioc.get()}, retryTimer {*ioc.get()}, threads {threads}
+            {
+            }
+        };
+
         boost::asio::ssl::context ctx;
         boost::asio::ip::tcp::endpoint endpoint;
-        boost::asio::ip::tcp::acceptor acceptor;
+        std::vector<std::unique_ptr<AcceptorShard>> shards;
+        std::unique_ptr<CryptoPool> cryptoPool;
+        std::unique_ptr<CertificateStore> certificates;
+        bool traceHandshake {};
+        bool enableControl {};
+        bool ktls {};
+        SocketOptions socketOptions {};
 
         /**
          * @brief Constructs the required object for a new `ServerListener` instance.
          */
-        ServerListener(uint16_t port);
+        ServerListener(ServerConfig const& config);
+
+        // Open, bind and listen the acceptor of a shard
+        core::Expect<void> listen(AcceptorShard& shard, bool reusePort);
+
+        // Queue the next asynchronous accept
+        void doAccept(AcceptorShard& shard);
+
+        // Hand the accepted socket over to a new `ServerSession`, or retry the accept after a short delay on failure
+        void onAccept(AcceptorShard& shard, boost::beast::error_code ec, boost::asio::ip::tcp::socket socket);
+
+        // Print the latency percentiles of the last interval, the accepted connections and the accept queue depth of
+        // every shard, and the crypto pool queue metrics periodically
+        void report(std::stop_token stopToken);
 
     public:
         ServerListener(ServerListener&& other):
-            ioc(std::move(other.ioc)), ctx(std::move(other.ctx)), endpoint(std::move(other.endpoint)),
-            acceptor(std::move(other.acceptor))
+            ctx(std::move(other.ctx)), endpoint(std::move(other.endpoint)), shards(std::move(other.shards)),
+            cryptoPool(std::move(other.cryptoPool)), certificates(std::move(other.certificates)),
+            traceHandshake(other.traceHandshake), enableControl(other.enableControl), ktls(other.ktls),
+            socketOptions(other.socketOptions)
         {
         }
         ServerListener& operator=(ServerListener&& other)
         {
-            this->ioc      = std::move(other.ioc);
-            this->ctx      = std::move(other.ctx);
-            this->endpoint = std::move(other.endpoint);
-            this->acceptor = std::move(other.acceptor);
+            this->ctx            = std::move(other.ctx);
+            this->endpoint       = std::move(other.endpoint);
+            this->shards         = std::move(other.shards);
+            this->cryptoPool     = std::move(other.cryptoPool);
+            this->certificates   = std::move(other.certificates);
+            this->traceHandshake = other.traceHandshake;
+            this->enableControl  = other.enableControl;
+            this->ktls           = other.ktls;
+            this->socketOptions  = other.socketOptions;
             return *this;
         }
         ServerListener(ServerListener const&)            = delete;
@@ -48,17 +155,31 @@ namespace lily::net
         /**
          * @brief Constructs a new `ServerListener` instance.
          *
-         * @param port The port number to listen on.
+         * @param config The listener configuration.
+         */
+        static core::Expect<ServerListener> create(ServerConfig const& config);
+
+        /**
+         * @brief Configures a server SSL context the same way as the listener, once its certificate chain and
+         * private key are loaded.
+         *
+         * Only the TLS settings of the configuration are used, so a context built in memory, such as the one of the
+         * handshake benchmark, behaves exactly like the listener. The certificate compression algorithms are parsed
+         * by the caller from `config.certCompression`. The chain of the context is only compressed with
+         * `compressChain`, a listener serving its certificates from a `CertificateStore` compresses them there.
          */
-        static core::Expect<ServerListener> create(uint16_t port, std::filesystem::path const& serverCertificatePath,
-                                                   std::filesystem::path const& privateKeyPath);
+        static core::Expect<void> configureContext(boost::asio::ssl::context& ctx, ServerConfig const& config,
+                                                   std::vector<int> const& compression, bool compressChain = true);
 
         /**
          * @brief Starts listening for incoming connections.
          *
          * This method initializes the network listener and begins accepting incoming
-         * connections. It should be called after constructing an instance of
-         * `ServerListener`.
+         * connections asynchronously. Every connection is served by the worker threads of
+         * the shard that accepted it, so this method blocks the calling thread until every
+         * `io_context` stops on interruption or termination, then prints and dumps the
+         * latency histograms of the whole run. It should be called after constructing
+         * an instance of `ServerListener`.
          */
         void run();
     };
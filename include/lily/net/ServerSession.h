@@ -3,35 +3,84 @@
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 #include <boost/beast.hpp>
-#include <boost/beast/http/message_generator.hpp>
 #include <boost/beast/ssl.hpp>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include <lily/net/CertificateStore.h>
+#include <lily/net/CryptoPool.h>
+#include <lily/net/HandshakeTrace.h>
+#include <lily/net/TlsStream.h>
 
 namespace lily::net
 {
-    class ServerSession
+    /**
+     * @brief Represents a single TLS connection accepted by the `ServerListener`.
+     *
+     * The session runs entirely asynchronously on the strand it was accepted on. It performs the TLS handshake,
+     * echoes every HTTP request body back to the client and records the duration of each step to the `ServerLog`.
+     * The body is relayed chunk by chunk as it arrives, so the memory of a session does not grow with the body size.
+     * The handshake may be offloaded to a `CryptoPool`, in which case the session returns to its strand afterwards.
+     * With kTLS, the relayed body is encrypted and decrypted by the kernel instead of OpenSSL.
+     */
+    class ServerSession: public std::enable_shared_from_this<ServerSession>
     {
     private:
-        boost::beast::ssl_stream<boost::beast::tcp_stream> stream;
+        TlsStream stream;
+        CryptoPool* cryptoPool;
+        CertificateStore* certificates;
+        uint64_t connectionId;
+        HandshakeTrace trace {};
+        bool traceHandshake;
         boost::beast::flat_buffer buffer {};
 
+        // The header is parsed first, then the parser moves to the body of an echo or of a control request
+        std::optional<boost::beast::http::request_parser<boost::beast::http::empty_body>> headerParser {};
+        std::optional<boost::beast::http::request_parser<boost::beast::http::buffer_body>> echoParser {};
+        std::optional<boost::beast::http::request_parser<boost::beast::http::string_body>> controlParser {};
+        boost::beast::http::response<boost::beast::http::buffer_body> res {};
+        std::optional<boost::beast::http::response_serializer<boost::beast::http::buffer_body>> serializer {};
+
+        // The chunk holding the part of the body being relayed, at most `BODY_CHUNK_SIZE`
+        std::vector<char> chunk {};
+
+        // Measurement of the current request, the read and write durations sum every chunk
+        std::chrono::high_resolution_clock::time_point beginTime {};
+        int64_t handshakeDuration {};
+        uint64_t readSize {};
+        int64_t readDuration {};
+        uint64_t writeSize {};
+        int64_t writeDuration {};
+
+        void onRun();
+        void onHandshake(boost::beast::error_code ec);
+        void doRead();
+        void onReadHeader(boost::beast::error_code ec, std::size_t bytesTransferred);
+        void doReadChunk();
+        void onReadChunk(boost::beast::error_code ec, std::size_t bytesTransferred);
+        void onReadControl(boost::beast::error_code ec, std::size_t bytesTransferred);
+        std::string_view onControl();
+        void rejectControl();
+        void doWrite(void const* data, std::size_t size, bool more);
+        void onWrite(boost::beast::error_code ec, std::size_t bytesTransferred);
+        void onShutdown(boost::beast::error_code ec);
+
     public:
-        ServerSession(ServerSession&& other): stream(std::move(other.stream)), buffer(std::move(other.buffer)) {}
-        ServerSession& operator=(ServerSession&& other)
-        {
-            this->stream = std::move(other.stream);
-            this->buffer = std::move(other.buffer);
-            return *this;
-        }
         ServerSession(ServerSession const&)            = delete;
         ServerSession& operator=(ServerSession const&) = delete;
 
-        // Take ownership of the socket
-        ServerSession(boost::asio::ip::tcp::socket&& socket, boost::asio::ssl::context& ctx):
-            stream(std::move(socket), ctx)
-        {
-        }
+        // Take ownership of the socket. When a `CryptoPool` is given, the handshake runs on the pool. When traced, the
+        // time of every handshake message is written to the `TraceLog`. The handshake bytes are always accounted. When
+        // a `CertificateStore` is given, the requests to the control target replace its certificate instead of echoing.
+        // With kTLS, the records are encrypted by the kernel once the handshake completes, when it supports them.
+        ServerSession(boost::asio::ip::tcp::socket&& socket, boost::asio::ssl::context& ctx,
+                      CryptoPool* cryptoPool = nullptr, bool traceHandshake = false,
+                      CertificateStore* certificates = nullptr, bool ktls = false);
 
-        // Start the synchronous operation
+        // Start the asynchronous operation
         void run();
 
         // Close the communication
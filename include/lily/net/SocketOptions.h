@@ -0,0 +1,33 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <cstdint>
+
+#include <lily/core/ErrorCode.h>
+
+namespace lily::net
+{
+    /**
+     * @brief The TCP options of the connections, shared by the server and the client.
+     */
+    struct SocketOptions
+    {
+        // Whether Nagle's algorithm is disabled, so a small TLS record is sent without waiting for the previous ACK
+        bool noDelay {};
+
+        // The `SO_LINGER` timeout of the close (in seconds). Zero aborts the connection with a reset, which skips the
+        // TIME_WAIT state. Negative keeps the default close.
+        int32_t lingerSeconds {-1};
+
+        // Whether TCP Fast Open is used. The client sends its ClientHello with the SYN once it holds a cookie of the
+        // server, and the server accepts it.
+        bool fastOpen {};
+    };
+
+    /**
+     * @brief Applies the options shared by both sides to a socket, either accepted or not connected yet.
+     *
+     * The Fast Open option depends on the side and is applied by the listener or the client instead.
+     */
+    core::Expect<void> applySocketOptions(boost::asio::ip::tcp::socket& socket, SocketOptions const& options);
+} // namespace lily::net
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <array>
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast.hpp>
+#include <cerrno>
+#include <memory>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <type_traits>
+#include <variant>
+
+#include <lily/core/ErrorCode.h>
+
+namespace lily::net
+{
+    /**
+     * @brief A TLS stream over a TCP connection, with the record layer optionally offloaded to the kernel (kTLS).
+     *
+     * By default the stream is a `boost::asio::ssl::stream`, where OpenSSL encrypts the records into memory buffers
+     * that Asio then writes to the socket. With kTLS, OpenSSL performs the I/O on the socket itself, which lets it hand
+     * the traffic keys to the kernel once the handshake completes (`SSL_OP_ENABLE_KTLS` must be set on the context).
+     * The application data is then encrypted and decrypted by the kernel, without the extra copy through OpenSSL.
+     *
+     * When the kernel or the cipher suite does not support kTLS, the stream falls back to the records encrypted by
+     * OpenSSL over the same socket. `isKernelSend()` and `isKernelReceive()` tell whether kTLS engaged.
+     */
+    class TlsStream
+    {
+    public:
+        using next_layer_type = boost::beast::tcp_stream;
+        using executor_type   = next_layer_type::executor_type;
+
+    private:
+        using SslStream = boost::asio::ssl::stream<next_layer_type>;
+
+        /**
+         * @brief The connection whose socket is read and written by OpenSSL directly.
+         */
+        struct SocketStream
+        {
+            next_layer_type next;
+            std::unique_ptr<SSL, decltype(&SSL_free)> ssl;
+
+            // The small buffers of a write gathered into a single record, as done by `boost::asio::ssl::stream`
+            std::array<char, 8192> writeStorage {};
+
+            SocketStream(next_layer_type&& next, boost::asio::ssl::context& ctx);
+        };
+
+        /**
+         * @brief A single OpenSSL call on a non-blocking socket, repeated whenever the socket becomes ready.
+         *
+         * Every step runs on the executor associated with the completion handler, including the first one, so a
+         * handshake bound to the `CryptoPool` runs there entirely and the handler is never invoked inline.
+         */
+        template<typename Operation, bool HAS_BYTES>
+        struct SocketOperation
+        {
+            SocketStream& stream;
+            Operation operation;
+            bool started {};
+
+            template<typename Self>
+            void operator()(Self& self, boost::system::error_code ec = {})
+            {
+                if (!this->started)
+                {
+                    this->started = true;
+                    return boost::asio::post(this->stream.next.get_executor(), std::move(self));
+                }
+                if (ec)
+                    return this->complete(self, ec, 0);
+
+                ERR_clear_error();
+                errno = 0;
+                std::size_t bytes {};
+                auto result {this->operation(this->stream.ssl.get(), bytes)};
+                if (result > 0)
+                    return this->complete(self, {}, bytes);
+
+                switch (SSL_get_error(this->stream.ssl.get(), result))
+                {
+                case SSL_ERROR_WANT_READ:
+                    return this->stream.next.socket().async_wait(boost::asio::socket_base::wait_read,
+                                                                 std::move(self));
+                case SSL_ERROR_WANT_WRITE:
+                    return this->stream.next.socket().async_wait(boost::asio::socket_base::wait_write,
+                                                                 std::move(self));
+                case SSL_ERROR_ZERO_RETURN:
+                    return this->complete(self, boost::asio::error::eof, 0);
+                default:
+                    return this->complete(self, getError(), 0);
+                }
+            }
+
+            template<typename Self>
+            void complete(Self& self, boost::system::error_code ec, std::size_t bytes)
+            {
+                if constexpr (HAS_BYTES)
+                    self.complete(ec, bytes);
+                else
+                    self.complete(ec);
+            }
+        };
+
+        std::variant<SslStream, SocketStream> stream;
+
+        // Create the stream of a connection, only a kTLS connection is read and written by OpenSSL directly
+        static std::variant<SslStream, SocketStream> makeStream(next_layer_type&& next, boost::asio::ssl::context& ctx,
+                                                                bool ktls);
+
+        // Map the error of the failed OpenSSL call to the errors reported by `boost::asio::ssl::stream`
+        static boost::system::error_code getError();
+
+        // Run a single OpenSSL call on the socket until it completes
+        template<typename Signature, typename Operation, typename Token>
+        auto asyncPerform(Operation operation, Token&& token)
+        {
+            auto& socketStream {std::get<SocketStream>(this->stream)};
+            return boost::asio::async_compose<Token, Signature>(
+                SocketOperation<Operation, std::is_same_v<Signature, void(boost::system::error_code, std::size_t)>> {
+                    socketStream, std::move(operation)},
+                token, socketStream.next);
+        }
+
+        // Returns the first non-empty buffer of a sequence, as OpenSSL reads or writes a single buffer at a time
+        template<typename Buffer, typename BufferSequence>
+        static Buffer getFirstBuffer(BufferSequence const& buffers)
+        {
+            auto end {boost::asio::buffer_sequence_end(buffers)};
+            for (auto it {boost::asio::buffer_sequence_begin(buffers)}; it != end; ++it)
+                if (Buffer buffer {*it}; buffer.size() > 0)
+                    return buffer;
+            return {};
+        }
+
+        // Returns the buffer written by a single record, gathering a sequence starting with small buffers
+        template<typename ConstBufferSequence>
+        boost::asio::const_buffer linearise(ConstBufferSequence const& buffers)
+        {
+            auto& storage {std::get<SocketStream>(this->stream).writeStorage};
+            auto first {getFirstBuffer<boost::asio::const_buffer>(buffers)};
+            if (first.size() >= storage.size() or first.size() == boost::asio::buffer_size(buffers))
+                return first;
+            return boost::asio::buffer(storage.data(), boost::asio::buffer_copy(boost::asio::buffer(storage), buffers));
+        }
+
+        // Hand the socket over to OpenSSL, once it is connected
+        void attachSocket();
+
+    public:
+        // Take ownership of an accepted socket
+        TlsStream(boost::asio::ip::tcp::socket&& socket, boost::asio::ssl::context& ctx, bool ktls);
+
+        // Create a socket that is not connected yet
+        TlsStream(executor_type const& executor, boost::asio::ssl::context& ctx, bool ktls);
+
+        executor_type get_executor() noexcept;
+        next_layer_type& next_layer() noexcept;
+        SSL* native_handle() noexcept;
+
+        // Whether the kernel encrypts the records sent, and decrypts the records received
+        bool isKernelSend() noexcept;
+        bool isKernelReceive() noexcept;
+
+        /**
+         * @brief Lets the connections of a context hand their records to the kernel once the handshake completes.
+         *
+         * Fails when the linked OpenSSL is built without kTLS. When the `tls` kernel module is not loaded, a warning
+         * is logged and every connection falls back to the records encrypted by OpenSSL.
+         *
+         * OpenSSL writes the socket of a kTLS connection without `MSG_NOSIGNAL`, unlike Asio, so the caller must
+         * ignore `SIGPIPE` for the whole process before any connection is made.
+         */
+        static core::Expect<void> enableKtls(SSL_CTX* ctx);
+
+        template<typename Token>
+        auto async_handshake(boost::asio::ssl::stream_base::handshake_type type, Token&& token)
+        {
+            if (auto* sslStream {std::get_if<SslStream>(&this->stream)})
+                return sslStream->async_handshake(type, std::forward<Token>(token));
+
+            this->attachSocket();
+            if (type == boost::asio::ssl::stream_base::client)
+                SSL_set_connect_state(this->native_handle());
+            else
+                SSL_set_accept_state(this->native_handle());
+            return this->asyncPerform<void(boost::system::error_code)>(
+                [](SSL* ssl, std::size_t&) { return SSL_do_handshake(ssl); }, std::forward<Token>(token));
+        }
+
+        template<typename Token>
+        auto async_shutdown(Token&& token)
+        {
+            if (auto* sslStream {std::get_if<SslStream>(&this->stream)})
+                return sslStream->async_shutdown(std::forward<Token>(token));
+
+            // Send the close notify, then wait for the one of the peer
+            return this->asyncPerform<void(boost::system::error_code)>(
+                [](SSL* ssl, std::size_t&)
+                {
+                    auto result {SSL_shutdown(ssl)};
+                    return result == 0 ? SSL_shutdown(ssl) : result;
+                },
+                std::forward<Token>(token));
+        }
+
+        template<typename MutableBufferSequence, typename Token>
+        auto async_read_some(MutableBufferSequence const& buffers, Token&& token)
+        {
+            if (auto* sslStream {std::get_if<SslStream>(&this->stream)})
+                return sslStream->async_read_some(buffers, std::forward<Token>(token));
+
+            auto buffer {getFirstBuffer<boost::asio::mutable_buffer>(buffers)};
+            return this->asyncPerform<void(boost::system::error_code, std::size_t)>(
+                [buffer](SSL* ssl, std::size_t& bytes)
+                { return buffer.size() == 0 ? 1 : SSL_read_ex(ssl, buffer.data(), buffer.size(), &bytes); },
+                std::forward<Token>(token));
+        }
+
+        template<typename ConstBufferSequence, typename Token>
+        auto async_write_some(ConstBufferSequence const& buffers, Token&& token)
+        {
+            if (auto* sslStream {std::get_if<SslStream>(&this->stream)})
+                return sslStream->async_write_some(buffers, std::forward<Token>(token));
+
+            auto buffer {this->linearise(buffers)};
+            return this->asyncPerform<void(boost::system::error_code, std::size_t)>(
+                [buffer](SSL* ssl, std::size_t& bytes)
+                { return buffer.size() == 0 ? 1 : SSL_write_ex(ssl, buffer.data(), buffer.size(), &bytes); },
+                std::forward<Token>(token));
+        }
+    };
+} // namespace lily::net
@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <ctime>
+#include <fmt/chrono.h>
+#include <fmt/color.h>
+#include <fnmatch.h>
+#include <fstream>
+#include <latch>
+#include <memory>
+#include <openssl/pem.h>
+#include <pthread.h>
+#include <sched.h>
+#include <spdlog/spdlog.h>
+#include <thread>
+
+#include <lily/bench/Algorithms.h>
+#include <lily/crypto/Key.h>
+
+using namespace lily::core;
+
+namespace lily::bench
+{
+    static auto BOOTSTRAP_TIME {std::time(nullptr)};
+
+    SignatureKey getSignatureKey(std::string const& sigalg)
+    {
+        auto separator {sigalg.find('+')};
+        if (separator == std::string::npos)
+            return {.algorithm = sigalg};
+
+        SignatureKey key {.algorithm = sigalg.substr(0, separator), .digest = sigalg.substr(separator + 1)};
+        if (key.algorithm == "ECDSA")
+        {
+            key.algorithm = "EC";
+            key.curve     = key.digest == "SHA256" ? "P-256" : key.digest == "SHA384" ? "P-384" : "P-521";
+        }
+        return key;
+    }
+
+    std::vector<std::string> splitAlgorithms(std::string_view algorithms)
+    {
+        std::vector<std::string> output {};
+        while (!algorithms.empty())
+        {
+            auto end {algorithms.find(':')};
+            if (auto name {algorithms.substr(0, end)}; !name.empty())
+                output.emplace_back(name);
+            if (end == std::string_view::npos)
+                break;
+            algorithms.remove_prefix(end + 1);
+        }
+        return output;
+    }
+
+    Expect<std::vector<std::string>> selectAlgorithms(std::string const& selected, std::string_view supported,
+                                                      std::string_view kind)
+    {
+        auto supportedNames {splitAlgorithms(supported)};
+        std::vector<std::string> names {};
+        for (auto const& pattern: splitAlgorithms(selected))
+        {
+            // A pattern selects every matching supported algorithm, in the order of the supported list
+            if (pattern.find_first_of("*?[") != std::string::npos)
+            {
+                auto matched {false};
+                for (auto const& name: supportedNames)
+                {
+                    if (fnmatch(pattern.c_str(), name.c_str(), 0) != 0)
+                        continue;
+                    matched = true;
+                    if (std::ranges::find(names, name) == names.end())
+                        names.push_back(name);
+                }
+                if (!matched)
+                {
+                    spdlog::error("No {} matches `{}`", kind, pattern);
+                    return ErrorCode::LILY_ERRORCODE_EXPECTED;
+                }
+                continue;
+            }
+
+            if (std::ranges::find(supportedNames, pattern) == supportedNames.end())
+            {
+                spdlog::error("Unsupported {} `{}`", kind, pattern);
+                return ErrorCode::LILY_ERRORCODE_EXPECTED;
+            }
+            if (std::ranges::find(names, pattern) == names.end())
+                names.push_back(pattern);
+        }
+        return names;
+    }
+
+    EVP_PKEY* newKey(char const* algorithm, char const* curve)
+    {
+        std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> ctx {
+            EVP_PKEY_CTX_new_from_name(nullptr, algorithm, nullptr), EVP_PKEY_CTX_free};
+        if (!ctx or EVP_PKEY_keygen_init(ctx.get()) != 1)
+            return nullptr;
+        if (curve != nullptr and EVP_PKEY_CTX_set_group_name(ctx.get(), curve) != 1)
+            return nullptr;
+
+        EVP_PKEY* key {};
+        if (EVP_PKEY_generate(ctx.get(), &key) != 1)
+            return nullptr;
+        return key;
+    }
+
+    Expect<std::pair<std::string, std::string>> generateCredentials(std::string const& sigalg)
+    {
+        auto signatureKey {getSignatureKey(sigalg)};
+        std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key {
+            newKey(signatureKey.algorithm.c_str(), signatureKey.curve), EVP_PKEY_free};
+        if (!key)
+        {
+            spdlog::error("Failed to generate a `{}` key, skipping it", sigalg);
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+
+        std::unique_ptr<BIO, decltype(&BIO_free)> privateKeyBIO {BIO_new(BIO_s_mem()), BIO_free};
+        if (!privateKeyBIO or
+            PEM_write_bio_PrivateKey(privateKeyBIO.get(), key.get(), nullptr, nullptr, 0, nullptr, nullptr) <= 0)
+        {
+            spdlog::error("Failed to write the `{}` private key, skipping it", sigalg);
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+        BUF_MEM* bptr {};
+        BIO_get_mem_ptr(privateKeyBIO.get(), &bptr);
+        std::string privateKey {bptr->data, bptr->length};
+
+        BOOST_OUTCOME_TRY(decltype(auto) certificate, crypto::generateSelfSignedPQCCert(privateKey));
+        return std::pair {std::move(certificate), std::move(privateKey)};
+    }
+
+    std::chrono::duration<double> runThreads(
+        uint32_t threads, std::function<void(uint32_t, std::chrono::steady_clock::time_point)> const& work,
+        std::vector<int> const& cores)
+    {
+        std::latch started {static_cast<std::ptrdiff_t>(threads) + 1};
+        std::chrono::steady_clock::time_point beginTime {};
+        {
+            std::vector<std::jthread> workers {};
+            for (uint32_t i {}; i < threads; ++i)
+            {
+                workers.emplace_back(
+                    [&, i]
+                    {
+                        started.arrive_and_wait();
+                        work(i, beginTime);
+                    });
+
+                // Shard the threads across the cores
+                if (!cores.empty())
+                {
+                    cpu_set_t set {};
+                    CPU_SET(cores[i % cores.size()], &set);
+                    pthread_setaffinity_np(workers.back().native_handle(), sizeof(set), &set);
+                }
+            }
+
+            // Start every thread at once, once they are all ready
+            beginTime = std::chrono::steady_clock::now();
+            started.arrive_and_wait();
+        }
+        return std::chrono::steady_clock::now() - beginTime;
+    }
+
+    Expect<void> writeResultFile(std::filesystem::path path, std::string_view defaultSuffix,
+                                 fmt::memory_buffer const& buffer)
+    {
+        if (path.empty())
+            path = fmt::format("{:%F_%T}_{}", fmt::localtime(BOOTSTRAP_TIME), defaultSuffix);
+
+        std::ofstream stream {path};
+        if (!stream.is_open())
+        {
+            spdlog::error("Failed to create benchmark result file {}", path.string());
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+        stream.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+
+        fmt::print(fmt::fg(fmt::color::green), "\r\n[v] Results written to {}\r\n", path.string());
+        return success;
+    }
+} // namespace lily::bench
@@ -0,0 +1,379 @@
+#include <algorithm>
+#include <atomic>
+#include <fmt/color.h>
+#include <fmt/core.h>
+#include <fmt/ranges.h>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+#include <spdlog/spdlog.h>
+
+#include <lily/bench/Algorithms.h>
+#include <lily/bench/CryptoBench.h>
+#include <lily/log/Histogram.h>
+
+using namespace lily::core;
+using namespace lily::log;
+
+namespace lily::bench
+{
+    using PKeyPtr = std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)>;
+    using PKeyCtxPtr = std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)>;
+    using MDCtxPtr = std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)>;
+
+    /**
+     * @brief The buffers written by a primitive, owned by a single thread and reused across calls.
+     */
+    struct Scratch
+    {
+        std::vector<uint8_t> output {};
+        std::size_t outputLength {};
+        std::vector<uint8_t> secret {};
+    };
+
+    // A single call of a primitive, returning `false` when it fails
+    using Primitive = std::function<bool(Scratch&)>;
+
+    /**
+     * @brief The content signed by the server in a TLS 1.3 CertificateVerify with a SHA-384 transcript hash.
+     */
+    static std::string const CERTIFICATE_VERIFY_CONTENT {
+        std::string(64, ' ') + std::string {"TLS 1.3, server CertificateVerify"} + std::string(1 + 48, '\0')};
+
+    static bool encapsulate(EVP_PKEY* key, Scratch& scratch)
+    {
+        PKeyCtxPtr ctx {EVP_PKEY_CTX_new_from_pkey(nullptr, key, nullptr), EVP_PKEY_CTX_free};
+        if (!ctx or EVP_PKEY_encapsulate_init(ctx.get(), nullptr) != 1)
+            return false;
+
+        scratch.outputLength = scratch.output.size();
+        auto secretLength {scratch.secret.size()};
+        return EVP_PKEY_encapsulate(ctx.get(), scratch.output.data(), &scratch.outputLength, scratch.secret.data(),
+                                    &secretLength) == 1;
+    }
+
+    static bool decapsulate(EVP_PKEY* key, std::vector<uint8_t> const& ciphertext, Scratch& scratch)
+    {
+        PKeyCtxPtr ctx {EVP_PKEY_CTX_new_from_pkey(nullptr, key, nullptr), EVP_PKEY_CTX_free};
+        if (!ctx or EVP_PKEY_decapsulate_init(ctx.get(), nullptr) != 1)
+            return false;
+
+        auto secretLength {scratch.secret.size()};
+        return EVP_PKEY_decapsulate(ctx.get(), scratch.secret.data(), &secretLength, ciphertext.data(),
+                                    ciphertext.size()) == 1;
+    }
+
+    static bool sign(EVP_PKEY* key, char const* digest, Scratch& scratch)
+    {
+        MDCtxPtr ctx {EVP_MD_CTX_new(), EVP_MD_CTX_free};
+        if (!ctx or EVP_DigestSignInit_ex(ctx.get(), nullptr, digest, nullptr, nullptr, key, nullptr) != 1)
+            return false;
+
+        scratch.outputLength = scratch.output.size();
+        return EVP_DigestSign(ctx.get(), scratch.output.data(), &scratch.outputLength,
+                              reinterpret_cast<uint8_t const*>(CERTIFICATE_VERIFY_CONTENT.data()),
+                              CERTIFICATE_VERIFY_CONTENT.size()) == 1;
+    }
+
+    static bool verify(EVP_PKEY* key, char const* digest, std::vector<uint8_t> const& signature)
+    {
+        MDCtxPtr ctx {EVP_MD_CTX_new(), EVP_MD_CTX_free};
+        if (!ctx or EVP_DigestVerifyInit_ex(ctx.get(), nullptr, digest, nullptr, nullptr, key, nullptr) != 1)
+            return false;
+
+        return EVP_DigestVerify(ctx.get(), signature.data(), signature.size(),
+                                reinterpret_cast<uint8_t const*>(CERTIFICATE_VERIFY_CONTENT.data()),
+                                CERTIFICATE_VERIFY_CONTENT.size()) == 1;
+    }
+
+    /**
+     * @brief Run a primitive back-to-back on every number of threads, and append its measurements to the report.
+     *
+     * Every thread starts from its own copy of the scratch buffers and records into its own histogram, so the threads
+     * only share the read-only keys. The first number of threads is always one, the baseline of the scaling
+     * efficiency.
+     */
+    static Expect<void> measure(CryptoBench::Report& report, CryptoBench::Operation operation,
+                                Primitive const& primitive, Scratch const& scratch,
+                                std::vector<uint32_t> const& threadCounts, std::chrono::milliseconds duration)
+    {
+        double singleThreadOpsPerSecond {};
+        for (auto threads: threadCounts)
+        {
+            std::vector<Histogram> histograms(threads);
+            std::vector<Scratch> scratches(threads, scratch);
+            std::atomic_bool failed {};
+            auto elapsed {runThreads(
+                threads,
+                [&](uint32_t i, std::chrono::steady_clock::time_point beginTime)
+                {
+                    auto deadline {beginTime + duration};
+                    auto callTime {std::chrono::steady_clock::now()};
+                    while (callTime < deadline)
+                    {
+                        if (!primitive(scratches[i]))
+                        {
+                            failed = true;
+                            return;
+                        }
+                        auto returnTime {std::chrono::steady_clock::now()};
+                        histograms[i].record(static_cast<uint64_t>(
+                            std::chrono::duration_cast<std::chrono::nanoseconds>(returnTime - callTime).count()));
+                        callTime = returnTime;
+                    }
+                })};
+
+            if (failed)
+            {
+                spdlog::error("Failed to run `{}` of `{}`", CryptoBench::getOperationName(operation),
+                              report.algorithm);
+                return ErrorCode::LILY_ERRORCODE_EXPECTED;
+            }
+
+            Histogram merged {};
+            for (auto const& histogram: histograms)
+                merged += histogram;
+
+            CryptoBench::Result result {.operation    = operation,
+                                        .threads      = threads,
+                                        .operations   = merged.count(),
+                                        .opsPerSecond = static_cast<double>(merged.count()) / elapsed.count(),
+                                        .p50Ns        = merged.percentile(50.0),
+                                        .p90Ns        = merged.percentile(90.0),
+                                        .p99Ns        = merged.percentile(99.0),
+                                        .maxNs        = merged.max()};
+            if (threads == 1)
+                singleThreadOpsPerSecond = result.opsPerSecond;
+            if (singleThreadOpsPerSecond > 0)
+                result.scalingEfficiency = result.opsPerSecond / (singleThreadOpsPerSecond * threads);
+            report.results.push_back(result);
+        }
+        return success;
+    }
+
+    CryptoBench::CryptoBench(CryptoBenchConfig const& config): config {config}
+    {
+        for (uint32_t threads {1}; threads < this->config.maxThreads; threads *= 2)
+            this->threadCounts.push_back(threads);
+        this->threadCounts.push_back(std::max(this->config.maxThreads, 1u));
+    }
+
+    char const* CryptoBench::getOperationName(Operation operation)
+    {
+        switch (operation)
+        {
+        case Operation::KEYGEN:
+            return "keygen";
+        case Operation::ENCAPS:
+            return "encaps";
+        case Operation::DECAPS:
+            return "decaps";
+        case Operation::SIGN:
+            return "sign";
+        case Operation::VERIFY:
+            return "verify";
+        }
+        return "unknown";
+    }
+
+    Expect<CryptoBench::Report> CryptoBench::measureKEM(std::string const& group) const
+    {
+        Report report {.algorithm = group, .kem = true};
+
+        // Generate the key, the ciphertext and the shared secret the encapsulation and the decapsulation work on
+        PKeyPtr key {newKey(group.c_str()), EVP_PKEY_free};
+        if (!key)
+        {
+            spdlog::error("Failed to generate a `{}` key, skipping it", group);
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+
+        uint8_t* encodedPublicKey {};
+        report.publicKeySize = EVP_PKEY_get1_encoded_public_key(key.get(), &encodedPublicKey);
+        OPENSSL_free(encodedPublicKey);
+
+        Scratch scratch {};
+        {
+            PKeyCtxPtr ctx {EVP_PKEY_CTX_new_from_pkey(nullptr, key.get(), nullptr), EVP_PKEY_CTX_free};
+            if (!ctx or EVP_PKEY_encapsulate_init(ctx.get(), nullptr) != 1 or
+                EVP_PKEY_encapsulate(ctx.get(), nullptr, &report.outputSize, nullptr, &report.sharedSecretSize) != 1)
+            {
+                spdlog::error("Failed to get the `{}` ciphertext size, skipping it", group);
+                return ErrorCode::LILY_ERRORCODE_EXPECTED;
+            }
+            scratch.output.resize(report.outputSize);
+            scratch.secret.resize(report.sharedSecretSize);
+        }
+
+        if (!encapsulate(key.get(), scratch))
+        {
+            spdlog::error("Failed to encapsulate with `{}`, skipping it", group);
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+        std::vector<uint8_t> ciphertext {scratch.output.begin(),
+                                         scratch.output.begin() + static_cast<std::ptrdiff_t>(scratch.outputLength)};
+
+        // The client generates a key share and decapsulates, the server encapsulates
+        auto keyPtr {key.get()};
+        BOOST_OUTCOME_TRY(measure(
+            report, Operation::KEYGEN,
+            [&group](Scratch&)
+            {
+                PKeyPtr generated {newKey(group.c_str()), EVP_PKEY_free};
+                return generated != nullptr;
+            },
+            scratch, this->threadCounts, this->config.duration));
+        BOOST_OUTCOME_TRY(measure(
+            report, Operation::ENCAPS, [keyPtr](Scratch& localScratch) { return encapsulate(keyPtr, localScratch); },
+            scratch, this->threadCounts, this->config.duration));
+        BOOST_OUTCOME_TRY(measure(
+            report, Operation::DECAPS,
+            [keyPtr, &ciphertext](Scratch& localScratch) { return decapsulate(keyPtr, ciphertext, localScratch); },
+            scratch, this->threadCounts, this->config.duration));
+        return report;
+    }
+
+    Expect<CryptoBench::Report> CryptoBench::measureSignature(std::string const& sigalg) const
+    {
+        Report report {.algorithm = sigalg, .kem = false};
+
+        auto signatureKey {getSignatureKey(sigalg)};
+        auto digestName {signatureKey.digest.empty() ? nullptr : signatureKey.digest.c_str()};
+
+        // Generate the key and the signature the signing and the verification work on
+        PKeyPtr key {newKey(signatureKey.algorithm.c_str(), signatureKey.curve), EVP_PKEY_free};
+        if (!key)
+        {
+            spdlog::error("Failed to generate a `{}` key, skipping it", sigalg);
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+        report.publicKeySize = static_cast<std::size_t>(std::max(i2d_PUBKEY(key.get(), nullptr), 0));
+
+        Scratch scratch {.output = std::vector<uint8_t>(static_cast<std::size_t>(EVP_PKEY_get_size(key.get())))};
+        if (!sign(key.get(), digestName, scratch))
+        {
+            spdlog::error("Failed to sign with `{}`, skipping it", sigalg);
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+        report.outputSize = scratch.outputLength;
+        std::vector<uint8_t> signature {scratch.output.begin(),
+                                        scratch.output.begin() + static_cast<std::ptrdiff_t>(scratch.outputLength)};
+
+        // The server signs the handshake transcript, the client verifies it
+        auto keyPtr {key.get()};
+        BOOST_OUTCOME_TRY(measure(
+            report, Operation::KEYGEN,
+            [&signatureKey](Scratch&)
+            {
+                PKeyPtr generated {newKey(signatureKey.algorithm.c_str(), signatureKey.curve), EVP_PKEY_free};
+                return generated != nullptr;
+            },
+            scratch, this->threadCounts, this->config.duration));
+        BOOST_OUTCOME_TRY(measure(
+            report, Operation::SIGN,
+            [keyPtr, digestName](Scratch& localScratch) { return sign(keyPtr, digestName, localScratch); }, scratch,
+            this->threadCounts, this->config.duration));
+        BOOST_OUTCOME_TRY(measure(
+            report, Operation::VERIFY,
+            [keyPtr, digestName, &signature](Scratch&) { return verify(keyPtr, digestName, signature); }, scratch,
+            this->threadCounts, this->config.duration));
+        return report;
+    }
+
+    void CryptoBench::printResults(Report const& report)
+    {
+        for (auto const& result: report.results)
+            fmt::print("{:<24} {:<7} {:>7} {:>12.1f} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.2f}\r\n",
+                       report.algorithm, getOperationName(result.operation), result.threads, result.opsPerSecond,
+                       result.p50Ns / 1e3, result.p90Ns / 1e3, result.p99Ns / 1e3, result.maxNs / 1e3,
+                       result.scalingEfficiency);
+    }
+
+    void CryptoBench::printSizes() const
+    {
+        fmt::print(fmt::fg(fmt::color::green), "\r\n[v] Sizes (in bytes):\r\n");
+        fmt::print("{:<24} {:<4} {:>10} {:>10} {:>13}\r\n", "algorithm", "type", "public_key", "ct/sig",
+                   "shared_secret");
+        for (auto const& report: this->reports)
+            fmt::print("{:<24} {:<4} {:>10} {:>10} {:>13}\r\n", report.algorithm, report.kem ? "kem" : "sig",
+                       report.publicKeySize, report.outputSize, report.sharedSecretSize);
+    }
+
+    Expect<void> CryptoBench::writeJSON() const
+    {
+        fmt::memory_buffer out {};
+        auto outIt {std::back_inserter(out)};
+        fmt::format_to(outIt, "{{\n  \"duration_ms\": {},\n  \"threads\": [{}],\n  \"algorithms\": [",
+                       this->config.duration.count(), fmt::join(this->threadCounts, ", "));
+        for (std::size_t i {}; i < this->reports.size(); ++i)
+        {
+            auto const& report {this->reports[i]};
+            fmt::format_to(outIt,
+                           "{}\n    {{\n      \"name\": \"{}\",\n      \"type\": \"{}\",\n"
+                           "      \"public_key_bytes\": {},\n      \"{}_bytes\": {},\n",
+                           i == 0 ? "" : ",", report.algorithm, report.kem ? "kem" : "sig", report.publicKeySize,
+                           report.kem ? "ciphertext" : "signature", report.outputSize);
+            if (report.kem)
+                fmt::format_to(outIt, "      \"shared_secret_bytes\": {},\n", report.sharedSecretSize);
+
+            fmt::format_to(outIt, "      \"results\": [");
+            for (std::size_t j {}; j < report.results.size(); ++j)
+            {
+                auto const& result {report.results[j]};
+                fmt::format_to(outIt,
+                               "{}\n        {{\"operation\": \"{}\", \"threads\": {}, \"operations\": {}, "
+                               "\"ops_per_second\": {:.1f}, \"p50_ns\": {}, \"p90_ns\": {}, \"p99_ns\": {}, "
+                               "\"max_ns\": {}, \"scaling_efficiency\": {:.3f}}}",
+                               j == 0 ? "" : ",", getOperationName(result.operation), result.threads,
+                               result.operations, result.opsPerSecond, result.p50Ns, result.p90Ns, result.p99Ns,
+                               result.maxNs, result.scalingEfficiency);
+            }
+            fmt::format_to(outIt, "\n      ]\n    }}");
+        }
+        fmt::format_to(outIt, "\n  ]\n}}\n");
+        return writeResultFile(this->config.jsonOutputPath, "bench_crypto.json", out);
+    }
+
+    Expect<void> CryptoBench::run()
+    {
+        BOOST_OUTCOME_TRY(decltype(auto) groups,
+                          selectAlgorithms(this->config.groups, constants::SUPPORTED_PQC_GROUPS_LIST, "KEM group"));
+        BOOST_OUTCOME_TRY(
+            decltype(auto) sigalgs,
+            selectAlgorithms(this->config.sigalgs, constants::SUPPORTED_SIGALGS_LIST, "signature algorithm"));
+
+        fmt::print(fmt::fg(fmt::color::green),
+                   "[v] Measuring {} KEM groups and {} signature algorithms on {} threads, {} ms each...\r\n",
+                   groups.size(), sigalgs.size(), fmt::join(this->threadCounts, "/"), this->config.duration.count());
+        fmt::print("{:<24} {:<7} {:>7} {:>12} {:>10} {:>10} {:>10} {:>10} {:>10}\r\n", "algorithm", "op", "threads",
+                   "ops/s", "p50_us", "p90_us", "p99_us", "max_us", "efficiency");
+
+        // An algorithm that cannot be set up is skipped, the error is already logged
+        for (auto const& group: groups)
+        {
+            if (auto report {this->measureKEM(group)})
+            {
+                printResults(report.value());
+                this->reports.push_back(std::move(report.value()));
+            }
+        }
+        for (auto const& sigalg: sigalgs)
+        {
+            if (auto report {this->measureSignature(sigalg)})
+            {
+                printResults(report.value());
+                this->reports.push_back(std::move(report.value()));
+            }
+        }
+
+        if (this->reports.empty())
+        {
+            spdlog::error("No algorithm could be measured");
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+        this->printSizes();
+        return this->writeJSON();
+    }
+} // namespace lily::bench
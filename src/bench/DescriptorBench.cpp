@@ -0,0 +1,92 @@
+#include <fmt/color.h>
+#include <fmt/core.h>
+#include <iterator>
+#include <oqs/oqs.h>
+
+#include <lily/bench/Algorithms.h>
+#include <lily/bench/DescriptorBench.h>
+#include <lily/crypto/OQSDescriptorCache.h>
+
+using namespace lily::core;
+
+// The original constructors and destructors, bypassing the descriptor cache
+extern "C"
+{
+    OQS_KEM* __real_OQS_KEM_new(char const* methodName);
+    void __real_OQS_KEM_free(OQS_KEM* kem);
+    OQS_SIG* __real_OQS_SIG_new(char const* methodName);
+    void __real_OQS_SIG_free(OQS_SIG* sig);
+}
+
+namespace lily::bench
+{
+    // The number of requests between two reads of the clock
+    static constexpr uint32_t REQUEST_BATCH {64};
+
+    // Returns the mean time of a request and its release, in ns
+    template<typename Request>
+    static double measure(std::chrono::milliseconds duration, Request&& request)
+    {
+        uint64_t requests {};
+        auto beginTime {std::chrono::steady_clock::now()};
+        auto endTime {beginTime};
+        do
+        {
+            for (uint32_t i {}; i < REQUEST_BATCH; ++i)
+                request();
+            requests += REQUEST_BATCH;
+            endTime = std::chrono::steady_clock::now();
+        } while (endTime - beginTime < duration);
+        return std::chrono::duration<double, std::nano> {endTime - beginTime}.count() / requests;
+    }
+
+    DescriptorBench::DescriptorBench(DescriptorBenchConfig const& config): config {config} {}
+
+    Expect<void> DescriptorBench::writeJSON() const
+    {
+        fmt::memory_buffer out {};
+        auto outIt {std::back_inserter(out)};
+        fmt::format_to(outIt, "{{\n  \"duration_ms\": {},\n  \"results\": [", this->config.duration.count());
+        for (std::size_t i {}; i < this->results.size(); ++i)
+        {
+            auto const& result {this->results[i]};
+            fmt::format_to(outIt,
+                           "{}\n    {{\"kind\": \"{}\", \"algorithm\": \"{}\", \"allocated_ns\": {:.1f}, "
+                           "\"cached_ns\": {:.1f}}}",
+                           i == 0 ? "" : ",", result.kind, result.algorithm, result.allocatedNs, result.cachedNs);
+        }
+        fmt::format_to(outIt, "\n  ]\n}}\n");
+        return writeResultFile(this->config.jsonOutputPath, "bench_descriptor.json", out);
+    }
+
+    Expect<void> DescriptorBench::run()
+    {
+        fmt::print(fmt::fg(fmt::color::green), "[v] Measuring the descriptor requests, {} ms each...\r\n",
+                   this->config.duration.count());
+        fmt::print("{:<4} {:<40} {:>12} {:>10} {:>10}\r\n", "kind", "algorithm", "allocated_ns", "cached_ns",
+                   "saved_ns");
+
+        auto add {[this](char const* kind, char const* name, auto&& allocated, auto&& cached)
+                  {
+                      auto const& row {this->results.emplace_back(Result {
+                          .kind        = kind,
+                          .algorithm   = name,
+                          .allocatedNs = measure(this->config.duration, allocated),
+                          .cachedNs    = measure(this->config.duration, cached),
+                      })};
+                      fmt::print("{:<4} {:<40} {:>12.1f} {:>10.1f} {:>10.1f}\r\n", row.kind, row.algorithm,
+                                 row.allocatedNs, row.cachedNs, row.allocatedNs - row.cachedNs);
+                  }};
+
+        // The cached requests go through the wrappers called by the oqs-provider, the allocated ones bypass them
+        for (int i {}; i < OQS_KEM_alg_count(); ++i)
+            if (auto* name {OQS_KEM_alg_identifier(i)}; OQS_KEM_alg_is_enabled(name))
+                add("kem", name, [name] { __real_OQS_KEM_free(__real_OQS_KEM_new(name)); },
+                    [name] { OQS_KEM_free(OQS_KEM_new(name)); });
+        for (int i {}; i < OQS_SIG_alg_count(); ++i)
+            if (auto* name {OQS_SIG_alg_identifier(i)}; OQS_SIG_alg_is_enabled(name))
+                add("sig", name, [name] { __real_OQS_SIG_free(__real_OQS_SIG_new(name)); },
+                    [name] { OQS_SIG_free(OQS_SIG_new(name)); });
+        return this->writeJSON();
+    }
+} // namespace lily::bench
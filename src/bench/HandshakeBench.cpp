@@ -0,0 +1,312 @@
+#include <atomic>
+#include <fmt/color.h>
+#include <fmt/core.h>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <sched.h>
+#include <spdlog/spdlog.h>
+#include <time.h>
+
+#include <lily/bench/Algorithms.h>
+#include <lily/bench/HandshakeBench.h>
+#include <lily/crypto/OQSDescriptorCache.h>
+#include <lily/log/Histogram.h>
+#include <lily/net/CertCompression.h>
+#include <lily/net/ClientConnection.h>
+#include <lily/net/HandshakeTrace.h>
+#include <lily/net/ServerListener.h>
+
+using namespace lily::core;
+using namespace lily::log;
+using namespace lily::net;
+
+namespace lily::bench
+{
+    // The most turns a handshake may take before it is considered stuck
+    static constexpr uint32_t MAX_HANDSHAKE_TURNS {64};
+
+    using SSLPtr = std::unique_ptr<SSL, decltype(&SSL_free)>;
+
+    /**
+     * @brief The time spent by each side of a handshake.
+     */
+    struct HandshakeCost
+    {
+        std::chrono::nanoseconds client {};
+        std::chrono::nanoseconds server {};
+    };
+
+    // Returns the CPU time consumed by the calling thread
+    static std::chrono::nanoseconds getThreadCPUTime()
+    {
+        timespec time {};
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+        return std::chrono::seconds {time.tv_sec} + std::chrono::nanoseconds {time.tv_nsec};
+    }
+
+    // Returns the cores the process may run on
+    static std::vector<int> getAllowedCores()
+    {
+        std::vector<int> cores {};
+        cpu_set_t set {};
+        if (sched_getaffinity(0, sizeof(set), &set) == 0)
+            for (int core {}; core < CPU_SETSIZE; ++core)
+                if (CPU_ISSET(core, &set))
+                    cores.push_back(core);
+        return cores;
+    }
+
+    // Run a side of the handshake until it completes or waits for the other side. Returns `false` when it fails.
+    static bool advance(SSL* ssl, bool& done, std::chrono::nanoseconds& spent)
+    {
+        if (done)
+            return true;
+
+        auto beginTime {std::chrono::steady_clock::now()};
+        auto status {SSL_do_handshake(ssl)};
+        spent += std::chrono::steady_clock::now() - beginTime;
+        if (status == 1)
+        {
+            done = true;
+            return true;
+        }
+        auto error {SSL_get_error(ssl, status)};
+        return error == SSL_ERROR_WANT_READ or error == SSL_ERROR_WANT_WRITE;
+    }
+
+    /**
+     * @brief Run a complete handshake between new connections of the client and the server contexts, in memory.
+     *
+     * The two sides take turns until both complete, and the time spent by each side, from the creation of its
+     * connection to its release, is added to the cost. The traces are only attached to account the bytes of a
+     * warm-up handshake.
+     */
+    static bool handshake(SSL_CTX* clientCtx, SSL_CTX* serverCtx, HandshakeCost& cost,
+                          HandshakeTrace* clientTrace = nullptr, HandshakeTrace* serverTrace = nullptr)
+    {
+        BIO* clientBIO {};
+        BIO* serverBIO {};
+        if (BIO_new_bio_pair(&clientBIO, 0, &serverBIO, 0) != 1)
+            return false;
+
+        auto beginTime {std::chrono::steady_clock::now()};
+        SSLPtr client {SSL_new(clientCtx), SSL_free};
+        auto clientCreatedTime {std::chrono::steady_clock::now()};
+        SSLPtr server {SSL_new(serverCtx), SSL_free};
+        cost.client += clientCreatedTime - beginTime;
+        cost.server += std::chrono::steady_clock::now() - clientCreatedTime;
+        if (!client or !server)
+        {
+            BIO_free(clientBIO);
+            BIO_free(serverBIO);
+            return false;
+        }
+
+        // Every connection owns its end of the pair
+        SSL_set_bio(client.get(), clientBIO, clientBIO);
+        SSL_set_bio(server.get(), serverBIO, serverBIO);
+        SSL_set_connect_state(client.get());
+        SSL_set_accept_state(server.get());
+        if (clientTrace != nullptr)
+            clientTrace->attach(client.get());
+        if (serverTrace != nullptr)
+            serverTrace->attach(server.get());
+
+        bool clientDone {};
+        bool serverDone {};
+        for (uint32_t turn {}; turn < MAX_HANDSHAKE_TURNS and !(clientDone and serverDone); ++turn)
+            if (!advance(client.get(), clientDone, cost.client) or !advance(server.get(), serverDone, cost.server))
+                return false;
+
+        beginTime = std::chrono::steady_clock::now();
+        client.reset();
+        auto clientReleasedTime {std::chrono::steady_clock::now()};
+        server.reset();
+        cost.client += clientReleasedTime - beginTime;
+        cost.server += std::chrono::steady_clock::now() - clientReleasedTime;
+        return clientDone and serverDone;
+    }
+
+    HandshakeBench::HandshakeBench(HandshakeBenchConfig const& config): config {config} {}
+
+    Expect<HandshakeBench::Result> HandshakeBench::measure(boost::asio::ssl::context& serverCtx,
+                                                           boost::asio::ssl::context& clientCtx,
+                                                           std::string const& group, std::string const& sigalg) const
+    {
+        Result result {.group = group, .sigalg = sigalg};
+
+        // A warm-up handshake checks the pair and accounts its bytes on the wire and its liboqs descriptors
+        {
+            auto beginDescriptors {crypto::getOQSDescriptorCounts()};
+            HandshakeCost cost {};
+            HandshakeTrace clientTrace {};
+            HandshakeTrace serverTrace {};
+            if (!handshake(clientCtx.native_handle(), serverCtx.native_handle(), cost, &clientTrace, &serverTrace))
+            {
+                spdlog::error("Failed to complete a `{}` handshake with a `{}` certificate, skipping it", group,
+                              sigalg);
+                return ErrorCode::LILY_ERRORCODE_EXPECTED;
+            }
+            clientTrace.finish(-1);
+            serverTrace.finish(-1);
+            result.clientBytes = clientTrace.getAccounting().bytesSent;
+            result.serverBytes = serverTrace.getAccounting().bytesSent;
+            auto endDescriptors {crypto::getOQSDescriptorCounts()};
+            result.oqsDescriptors = endDescriptors.cached + endDescriptors.allocated - beginDescriptors.cached -
+                                    beginDescriptors.allocated;
+        }
+
+        auto threads {std::max(this->config.threads, 1u)};
+        auto cores {getAllowedCores()};
+        std::vector<Histogram> totalHistograms(threads);
+        std::vector<Histogram> clientHistograms(threads);
+        std::vector<Histogram> serverHistograms(threads);
+        std::vector<std::chrono::nanoseconds> cpuTimes(threads);
+        std::atomic_bool failed {};
+
+        // Shard the handshakes across the cores
+        auto elapsed {runThreads(
+            threads,
+            [&](uint32_t i, std::chrono::steady_clock::time_point beginTime)
+            {
+                auto deadline {beginTime + this->config.duration};
+                auto beginCPUTime {getThreadCPUTime()};
+                while (std::chrono::steady_clock::now() < deadline)
+                {
+                    HandshakeCost cost {};
+                    if (!handshake(clientCtx.native_handle(), serverCtx.native_handle(), cost))
+                    {
+                        failed = true;
+                        break;
+                    }
+                    clientHistograms[i].record(static_cast<uint64_t>(cost.client.count()));
+                    serverHistograms[i].record(static_cast<uint64_t>(cost.server.count()));
+                    totalHistograms[i].record(static_cast<uint64_t>((cost.client + cost.server).count()));
+                }
+                cpuTimes[i] = getThreadCPUTime() - beginCPUTime;
+            },
+            cores)};
+
+        if (failed)
+        {
+            spdlog::error("Failed to complete a `{}` handshake with a `{}` certificate", group, sigalg);
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+
+        Histogram total {};
+        Histogram client {};
+        Histogram server {};
+        for (uint32_t i {}; i < threads; ++i)
+        {
+            total += totalHistograms[i];
+            client += clientHistograms[i];
+            server += serverHistograms[i];
+        }
+        auto cpuTime {std::accumulate(cpuTimes.begin(), cpuTimes.end(), std::chrono::nanoseconds {})};
+
+        result.handshakes                 = total.count();
+        result.handshakesPerSecond        = static_cast<double>(total.count()) / elapsed.count();
+        result.handshakesPerSecondPerCore = result.handshakesPerSecond / threads;
+        result.cpuUsPerHandshake          = total.count() == 0 ? 0.0 : cpuTime.count() / 1e3 / total.count();
+        result.p50Ns                      = total.percentile(50.0);
+        result.p99Ns                      = total.percentile(99.0);
+        result.clientP50Ns                = client.percentile(50.0);
+        result.serverP50Ns                = server.percentile(50.0);
+        return result;
+    }
+
+    Expect<void> HandshakeBench::writeJSON() const
+    {
+        fmt::memory_buffer out {};
+        auto outIt {std::back_inserter(out)};
+        fmt::format_to(outIt, "{{\n  \"duration_ms\": {},\n  \"threads\": {},\n  \"results\": [",
+                       this->config.duration.count(), std::max(this->config.threads, 1u));
+        for (std::size_t i {}; i < this->results.size(); ++i)
+        {
+            auto const& result {this->results[i]};
+            fmt::format_to(outIt,
+                           "{}\n    {{\"group\": \"{}\", \"sigalg\": \"{}\", \"handshakes\": {}, "
+                           "\"handshakes_per_second\": {:.1f}, \"handshakes_per_second_per_core\": {:.1f}, "
+                           "\"cpu_us_per_handshake\": {:.1f}, \"p50_ns\": {}, \"p99_ns\": {}, \"client_p50_ns\": {}, "
+                           "\"server_p50_ns\": {}, \"client_bytes\": {}, \"server_bytes\": {}, "
+                           "\"oqs_descriptors\": {}}}",
+                           i == 0 ? "" : ",", result.group, result.sigalg, result.handshakes,
+                           result.handshakesPerSecond, result.handshakesPerSecondPerCore, result.cpuUsPerHandshake,
+                           result.p50Ns, result.p99Ns, result.clientP50Ns, result.serverP50Ns, result.clientBytes,
+                           result.serverBytes, result.oqsDescriptors);
+        }
+        fmt::format_to(outIt, "\n  ]\n}}\n");
+        return writeResultFile(this->config.jsonOutputPath, "bench_handshake.json", out);
+    }
+
+    Expect<void> HandshakeBench::run()
+    {
+        BOOST_OUTCOME_TRY(decltype(auto) groups,
+                          selectAlgorithms(this->config.groups, constants::SUPPORTED_PQC_GROUPS_LIST, "KEM group"));
+        BOOST_OUTCOME_TRY(
+            decltype(auto) sigalgs,
+            selectAlgorithms(this->config.sigalgs, constants::SUPPORTED_SIGALGS_LIST, "signature algorithm"));
+        BOOST_OUTCOME_TRY(decltype(auto) compression, parseCertCompression(this->config.certCompression));
+
+        fmt::print(fmt::fg(fmt::color::green),
+                   "[v] Measuring {} KEM groups with {} signature algorithms on {} threads, {} ms each...\r\n",
+                   groups.size(), sigalgs.size(), std::max(this->config.threads, 1u), this->config.duration.count());
+        fmt::print("{:<20} {:<18} {:>10} {:>10} {:>10} {:>10} {:>10} {:>10} {:>10} {:>9} {:>9} {:>8}\r\n", "group",
+                   "sigalg", "hs/s", "hs/s/core", "cpu_us", "p50_us", "p99_us", "client_us", "server_us", "client_B",
+                   "server_B", "oqs_desc");
+
+        // A pair that cannot be set up is skipped, the error is already logged
+        for (auto const& sigalg: sigalgs)
+        {
+            auto credentials {generateCredentials(sigalg)};
+            if (!credentials)
+                continue;
+
+            // Configure the server like `ServerListener`, with the certificate and the private key held in memory
+            boost::beast::error_code ec {};
+            boost::asio::ssl::context serverCtx {boost::asio::ssl::context::tlsv13_server};
+            std::ignore = serverCtx.use_certificate_chain(boost::asio::buffer(credentials.value().first), ec);
+            if (!ec)
+                std::ignore = serverCtx.use_private_key(boost::asio::buffer(credentials.value().second),
+                                                        boost::asio::ssl::context::pem, ec);
+            if (ec)
+            {
+                spdlog::error("Failed to load the `{}` certificate, skipping it. Why: {}", sigalg, ec.message());
+                continue;
+            }
+            if (!ServerListener::configureContext(serverCtx,
+                                                  ServerConfig {.certCompression = this->config.certCompression},
+                                                  compression))
+                continue;
+
+            for (auto const& group: groups)
+            {
+                // Configure the client like `ClientConnection`, offering only the measured group
+                boost::asio::ssl::context clientCtx {boost::asio::ssl::context::tlsv13_client};
+                if (!ClientConnection::configureContext(
+                        clientCtx, ClientConfig {.tlsGroup = group, .certCompression = this->config.certCompression}))
+                    continue;
+
+                auto result {this->measure(serverCtx, clientCtx, group, sigalg)};
+                if (!result)
+                    continue;
+
+                auto const& row {result.value()};
+                fmt::print("{:<20} {:<18} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f} {:>9} "
+                           "{:>9} {:>8}\r\n",
+                           row.group, row.sigalg, row.handshakesPerSecond, row.handshakesPerSecondPerCore,
+                           row.cpuUsPerHandshake, row.p50Ns / 1e3, row.p99Ns / 1e3, row.clientP50Ns / 1e3,
+                           row.serverP50Ns / 1e3, row.clientBytes, row.serverBytes, row.oqsDescriptors);
+                this->results.push_back(std::move(result.value()));
+            }
+        }
+
+        if (this->results.empty())
+        {
+            spdlog::error("No handshake could be measured");
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+        return this->writeJSON();
+    }
+} // namespace lily::bench
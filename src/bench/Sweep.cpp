@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <fmt/color.h>
+#include <fmt/core.h>
+#include <fmt/ranges.h>
+#include <fstream>
+#include <iterator>
+#include <spdlog/spdlog.h>
+#include <sstream>
+
+#include <lily/bench/Algorithms.h>
+#include <lily/bench/Sweep.h>
+#include <lily/net/ClientConnection.h>
+
+using namespace lily::core;
+using namespace lily::log;
+using namespace lily::net;
+
+namespace lily::bench
+{
+    // Read a whole credentials file, fails when it cannot be read or is empty
+    static Expect<std::string> readFile(std::filesystem::path const& path)
+    {
+        std::ifstream stream {path};
+        std::stringstream content {};
+        if (!stream.is_open() or !(content << stream.rdbuf()))
+        {
+            spdlog::error("Failed to read the credentials file {}", path.string());
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+        return content.str();
+    }
+
+    Sweep::Sweep(SweepConfig const& config): config {config} {}
+
+    Expect<std::string> Sweep::loadCredentials(std::string const& sigalg) const
+    {
+        if (this->config.credentialsDirectory.empty())
+        {
+            BOOST_OUTCOME_TRY(decltype(auto) credentials, generateCredentials(sigalg));
+            return credentials.first + credentials.second;
+        }
+
+        // Reuse the saved credentials, so every sweep runs against the same certificates
+        auto certificatePath {this->config.credentialsDirectory / fmt::format("{}.crt", sigalg)};
+        auto privateKeyPath {this->config.credentialsDirectory / fmt::format("{}.key", sigalg)};
+        if (std::filesystem::exists(certificatePath) and std::filesystem::exists(privateKeyPath))
+        {
+            BOOST_OUTCOME_TRY(decltype(auto) certificate, readFile(certificatePath));
+            BOOST_OUTCOME_TRY(decltype(auto) privateKey, readFile(privateKeyPath));
+            return certificate + privateKey;
+        }
+
+        BOOST_OUTCOME_TRY(decltype(auto) credentials, generateCredentials(sigalg));
+        std::error_code ec {};
+        std::filesystem::create_directories(this->config.credentialsDirectory, ec);
+        std::ofstream certificateStream {certificatePath};
+        std::ofstream privateKeyStream {privateKeyPath};
+        if (ec or !certificateStream.is_open() or !privateKeyStream.is_open())
+        {
+            spdlog::error("Failed to save the `{}` credentials to {}", sigalg,
+                          this->config.credentialsDirectory.string());
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+        certificateStream << credentials.first;
+        privateKeyStream << credentials.second;
+        return credentials.first + credentials.second;
+    }
+
+    void Sweep::print() const
+    {
+        fmt::print(fmt::fg(fmt::color::green), "\r\n[v] Sweep results:\r\n");
+        fmt::print("{:<20} {:<18} {:>9} {:>7} {:>10} {:>10} {:>10} {:>10} {:>10} {:>10} {:>9} {:>9}\r\n", "group",
+                   "sigalg", "requests", "failed", "req/s", "hs_p50_us", "hs_p99_us", "p50_us", "p90_us", "p99_us",
+                   "hs_sent_B", "hs_recv_B");
+        for (auto const& row: this->results)
+            fmt::print("{:<20} {:<18} {:>9} {:>7} {:>10.1f} {:>10} {:>10} {:>10} {:>10} {:>10} {:>9} {:>9}\r\n",
+                       row.group, row.sigalg, row.successfulRequests, row.failedRequests, row.requestsPerSecond,
+                       row.handshakeP50Us, row.handshakeP99Us, row.p50Us, row.p90Us, row.p99Us, row.hsBytesSent,
+                       row.hsBytesRecv);
+    }
+
+    Expect<void> Sweep::writeJSON() const
+    {
+        fmt::memory_buffer out {};
+        auto outIt {std::back_inserter(out)};
+        fmt::format_to(outIt,
+                       "{{\n  \"concurrent_users\": {},\n  \"duration_s\": {},\n  \"request_limit\": {},\n  "
+                       "\"data_length\": {},\n  \"results\": [",
+                       this->config.load.concurrentUsers, this->config.load.duration.count(),
+                       this->config.load.requestLimit, this->config.load.client.dummyDataLength);
+        for (std::size_t i {}; i < this->results.size(); ++i)
+        {
+            auto const& result {this->results[i]};
+            fmt::format_to(outIt,
+                           "{}\n    {{\"group\": \"{}\", \"sigalg\": \"{}\", \"successful_requests\": {}, "
+                           "\"failed_requests\": {}, \"requests_per_second\": {:.1f}, \"handshake_p50_us\": {}, "
+                           "\"handshake_p99_us\": {}, \"p50_us\": {}, \"p90_us\": {}, \"p99_us\": {}, "
+                           "\"hs_bytes_sent\": {}, \"hs_bytes_recv\": {}}}",
+                           i == 0 ? "" : ",", result.group, result.sigalg, result.successfulRequests,
+                           result.failedRequests, result.requestsPerSecond, result.handshakeP50Us,
+                           result.handshakeP99Us, result.p50Us, result.p90Us, result.p99Us, result.hsBytesSent,
+                           result.hsBytesRecv);
+        }
+        fmt::format_to(outIt, "\n  ]\n}}\n");
+        return writeResultFile(this->config.jsonOutputPath, "sweep.json", out);
+    }
+
+    Expect<void> Sweep::run()
+    {
+        BOOST_OUTCOME_TRY(decltype(auto) groups,
+                          selectAlgorithms(this->config.groups, constants::SUPPORTED_PQC_GROUPS_LIST, "KEM group"));
+        BOOST_OUTCOME_TRY(
+            decltype(auto) sigalgs,
+            selectAlgorithms(this->config.sigalgs, constants::SUPPORTED_SIGALGS_LIST, "signature algorithm"));
+
+        // The control requests offer every swept group, so they do not depend on a single one
+        auto controlConfig {this->config.load.client};
+        controlConfig.tlsGroup = fmt::format("{}", fmt::join(groups, ":"));
+        BOOST_OUTCOME_TRY(decltype(auto) control, ClientConnection::create(controlConfig));
+
+        fmt::print(fmt::fg(fmt::color::green), "[v] Sweeping {} KEM groups with {} signature algorithms...\r\n",
+                   groups.size(), sigalgs.size());
+
+        auto interrupted {false};
+        for (std::size_t i {}; i < sigalgs.size() and !interrupted; ++i)
+        {
+            auto const& sigalg {sigalgs[i]};
+
+            // A signature algorithm that cannot be set up is skipped, the error is already logged
+            auto credentials {this->loadCredentials(sigalg)};
+            if (!credentials)
+                continue;
+
+            // Every following handshake of the server uses the new certificate
+            BOOST_OUTCOME_TRY(control.sendControl(constants::CONTROL_CREDENTIALS_TARGET, credentials.value()));
+
+            for (std::size_t j {}; j < groups.size() and !interrupted; ++j)
+            {
+                auto const& group {groups[j]};
+                fmt::print(fmt::fg(fmt::color::green), "[v] Sweeping `{}` with a `{}` certificate ({}/{})...\r\n",
+                           group, sigalg, i * groups.size() + j + 1, sigalgs.size() * groups.size());
+
+                auto load {this->config.load};
+                load.client.tlsGroup = group;
+                LoadGenerator generator {load};
+                if (!generator.run())
+                    continue;
+
+                auto const& summary {generator.getSummary()};
+                auto const& latency {*summary.latency};
+                auto const& handshake {latency[static_cast<std::size_t>(LatencyRecorder::Metric::HANDSHAKE)]};
+                auto const& total {latency[static_cast<std::size_t>(LatencyRecorder::Metric::TOTAL)]};
+                std::chrono::duration<double> elapsed {summary.elapsed};
+                auto requests {summary.successfulRequests + summary.failedRequests};
+                auto handshakes {std::max(summary.handshakes, uint64_t {1})};
+                this->results.push_back({
+                    .group              = group,
+                    .sigalg             = sigalg,
+                    .successfulRequests = summary.successfulRequests,
+                    .failedRequests     = summary.failedRequests,
+                    .requestsPerSecond  = elapsed.count() == 0 ? 0.0 : requests / elapsed.count(),
+                    .handshakeP50Us     = handshake.percentile(50.0),
+                    .handshakeP99Us     = handshake.percentile(99.0),
+                    .p50Us              = total.percentile(50.0),
+                    .p90Us              = total.percentile(90.0),
+                    .p99Us              = total.percentile(99.0),
+                    .hsBytesSent        = summary.hsBytesSent / handshakes,
+                    .hsBytesRecv        = summary.hsBytesRecv / handshakes,
+                });
+                interrupted = summary.interrupted;
+            }
+        }
+
+        if (this->results.empty())
+        {
+            spdlog::error("No pair could be measured");
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+        this->print();
+        return this->writeJSON();
+    }
+} // namespace lily::bench
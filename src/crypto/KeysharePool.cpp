@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <spdlog/spdlog.h>
+
+#include <lily/crypto/KeysharePool.h>
+
+// The original key generation, the pool does not go through the wrapper that takes from the pool
+extern "C" OQS_STATUS __real_OQS_KEM_keypair(OQS_KEM const* kem, uint8_t* publicKey, uint8_t* secretKey);
+
+namespace lily::crypto
+{
+    KeysharePool& KeysharePool::getInstance()
+    {
+        static KeysharePool instance {};
+        return instance;
+    }
+
+    void KeysharePool::start(std::size_t capacity, uint32_t threads)
+    {
+        this->stop();
+
+        // Publish a pool for every algorithm once, the key generations then look them up without a lock
+        if (this->pools.empty())
+            for (int i {}; i < OQS_KEM_alg_count(); ++i)
+            {
+                auto identifier {OQS_KEM_alg_identifier(static_cast<std::size_t>(i))};
+                if (identifier == nullptr or !OQS_KEM_alg_is_enabled(identifier))
+                    continue;
+                std::unique_ptr<OQS_KEM, decltype(&OQS_KEM_free)> kem {OQS_KEM_new(identifier), &OQS_KEM_free};
+                if (kem == nullptr)
+                    continue;
+                this->pools.try_emplace(identifier, std::make_unique<AlgorithmPool>(std::move(kem)));
+            }
+        for (auto& [algorithm, pool]: this->pools)
+        {
+            std::lock_guard lock {pool->mtx};
+            pool->keys.clear();
+            pool->hits   = 0;
+            pool->misses = 0;
+            pool->available.store(0, std::memory_order_relaxed);
+            pool->requested.store(false, std::memory_order_relaxed);
+            pool->failed.store(false, std::memory_order_relaxed);
+        }
+
+        this->capacity = capacity;
+        this->lowWater = std::max<std::size_t>(capacity / 2, 1);
+        for (uint32_t i {}; i < threads; ++i)
+            this->threads.emplace_back(std::bind_front(&KeysharePool::fill, this));
+        this->enabled.store(true, std::memory_order_release);
+    }
+
+    void KeysharePool::stop()
+    {
+        this->enabled.store(false, std::memory_order_release);
+        this->threads.clear();
+    }
+
+    KeysharePool::AlgorithmPool* KeysharePool::findEmptiest()
+    {
+        AlgorithmPool* emptiest {};
+        std::size_t fewest {this->capacity};
+        for (auto& [algorithm, pool]: this->pools)
+        {
+            auto available {pool->available.load(std::memory_order_relaxed)};
+            if (pool->requested.load(std::memory_order_relaxed) and !pool->failed.load(std::memory_order_relaxed) and
+                available < fewest)
+            {
+                emptiest = pool.get();
+                fewest   = available;
+            }
+        }
+        return emptiest;
+    }
+
+    void KeysharePool::notifyFillers()
+    {
+        // Taking the lock orders the wake-up after a filler that found every pool full started waiting
+        {
+            std::lock_guard lock {this->mtx};
+        }
+        this->keysNeeded.notify_all();
+    }
+
+    void KeysharePool::fill(std::stop_token stopToken)
+    {
+        std::unique_lock lock {this->mtx};
+        while (!stopToken.stop_requested())
+        {
+            auto* pool {this->findEmptiest()};
+            if (pool == nullptr)
+            {
+                this->keysNeeded.wait(lock, stopToken, [this] { return this->findEmptiest() != nullptr; });
+                continue;
+            }
+
+            // Reserve the key pair, then generate it outside of any lock, the handshakes keep taking meanwhile
+            pool->available.fetch_add(1, std::memory_order_relaxed);
+            lock.unlock();
+            auto* kem {pool->kem.get()};
+            std::vector<uint8_t> key(kem->length_public_key + kem->length_secret_key);
+            auto status {__real_OQS_KEM_keypair(kem, key.data(), key.data() + kem->length_public_key)};
+
+            // A failed algorithm is no longer filled, its key generation misses once its pool is empty
+            if (status != OQS_SUCCESS)
+            {
+                pool->available.fetch_sub(1, std::memory_order_relaxed);
+                if (!pool->failed.exchange(true, std::memory_order_relaxed))
+                    spdlog::error("Keyshare pool generation of {} failed! Cause: OQS_KEM_keypair", kem->method_name);
+            }
+            else
+            {
+                std::lock_guard poolLock {pool->mtx};
+                pool->keys.push_back(std::move(key));
+            }
+            lock.lock();
+        }
+    }
+
+    bool KeysharePool::take(OQS_KEM const* kem, uint8_t* publicKey, uint8_t* secretKey)
+    {
+        if (!this->enabled.load(std::memory_order_acquire) or kem->method_name == nullptr)
+            return false;
+        auto it {this->pools.find(std::string_view {kem->method_name})};
+        if (it == this->pools.end())
+            return false;
+        auto& pool {*it->second};
+
+        // The first key generation of an algorithm starts filling its pool
+        if (!pool.requested.load(std::memory_order_relaxed) and !pool.requested.exchange(true))
+            this->notifyFillers();
+
+        std::vector<uint8_t> key {};
+        {
+            std::lock_guard lock {pool.mtx};
+            if (pool.keys.empty())
+            {
+                ++pool.misses;
+                return false;
+            }
+            key = std::move(pool.keys.front());
+            pool.keys.pop_front();
+            ++pool.hits;
+        }
+
+        // Only wake the fillers up once the pool drops below its low-water mark
+        if (pool.available.fetch_sub(1, std::memory_order_relaxed) == this->lowWater)
+            this->notifyFillers();
+
+        std::memcpy(publicKey, key.data(), kem->length_public_key);
+        std::memcpy(secretKey, key.data() + kem->length_public_key, kem->length_secret_key);
+        return true;
+    }
+
+    std::vector<KeysharePool::Statistics> KeysharePool::getStatistics() const
+    {
+        std::vector<Statistics> statistics {};
+        for (auto const& [algorithm, pool]: this->pools)
+        {
+            if (!pool->requested.load(std::memory_order_relaxed))
+                continue;
+            std::lock_guard lock {pool->mtx};
+            statistics.push_back({.algorithm = algorithm, .hits = pool->hits, .misses = pool->misses});
+        }
+        return statistics;
+    }
+} // namespace lily::crypto
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <openssl/crypto.h>
+#include <spdlog/spdlog.h>
+
+#include <lily/crypto/MemoryAccounting.h>
+
+using namespace lily::core;
+
+namespace lily::crypto
+{
+    /**
+     * @brief The allocations of a thread since its owner last flushed them.
+     */
+    struct ThreadUsage
+    {
+        // The id of the account owning the thread, zero when there is none
+        uint64_t owner {};
+        int64_t netBytes {};
+        int64_t peakNetBytes {};
+        uint64_t allocatedBytes {};
+        uint64_t allocations {};
+    };
+
+    /**
+     * @brief Kept right before every allocation, in a header preserving the alignment of `malloc`.
+     */
+    struct BlockHeader
+    {
+        std::size_t size {};
+
+        // The id of the account owning the thread that allocated the block
+        uint64_t owner {};
+    };
+    static constexpr std::size_t HEADER_SIZE {std::max(sizeof(BlockHeader), alignof(std::max_align_t))};
+
+    static thread_local ThreadUsage THREAD_USAGE {};
+    static std::atomic_uint64_t NEXT_ACCOUNT_ID {1};
+
+    static BlockHeader readHeader(unsigned char const* block)
+    {
+        BlockHeader header {};
+        std::memcpy(&header, block, sizeof(header));
+        return header;
+    }
+
+    // Tag a new block with the owner of the thread and account it
+    static void* writeHeader(unsigned char* block, std::size_t size)
+    {
+        auto& thread {THREAD_USAGE};
+        BlockHeader header {.size = size, .owner = thread.owner};
+        std::memcpy(block, &header, sizeof(header));
+
+        thread.netBytes += static_cast<int64_t>(size);
+        thread.peakNetBytes = std::max(thread.peakNetBytes, thread.netBytes);
+        thread.allocatedBytes += size;
+        ++thread.allocations;
+        return block + HEADER_SIZE;
+    }
+
+    // Take a released block off the account that allocated it, when it owns the thread
+    static void releaseBlock(BlockHeader const& header)
+    {
+        auto& thread {THREAD_USAGE};
+        if (header.owner != 0 and header.owner == thread.owner)
+            thread.netBytes -= static_cast<int64_t>(header.size);
+    }
+
+    static void* accountedMalloc(std::size_t size, char const*, int)
+    {
+        auto* block {static_cast<unsigned char*>(std::malloc(HEADER_SIZE + size))};
+        if (block == nullptr)
+            return nullptr;
+        return writeHeader(block, size);
+    }
+
+    static void accountedFree(void* ptr, char const*, int)
+    {
+        if (ptr == nullptr)
+            return;
+        auto* block {static_cast<unsigned char*>(ptr) - HEADER_SIZE};
+        releaseBlock(readHeader(block));
+        std::free(block);
+    }
+
+    static void* accountedRealloc(void* ptr, std::size_t size, char const* file, int line)
+    {
+        if (ptr == nullptr)
+            return accountedMalloc(size, file, line);
+        if (size == 0)
+        {
+            accountedFree(ptr, file, line);
+            return nullptr;
+        }
+
+        auto* block {static_cast<unsigned char*>(ptr) - HEADER_SIZE};
+        auto released {readHeader(block)};
+        block = static_cast<unsigned char*>(std::realloc(block, HEADER_SIZE + size));
+        if (block == nullptr)
+            return nullptr;
+        releaseBlock(released);
+        return writeHeader(block, size);
+    }
+
+    Expect<void> enableMemoryAccounting()
+    {
+        if (CRYPTO_set_mem_functions(&accountedMalloc, &accountedRealloc, &accountedFree) != 1)
+        {
+            spdlog::error("Failed to replace the OpenSSL allocator, it already allocated. Cause: "
+                          "CRYPTO_set_mem_functions");
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+        return success;
+    }
+
+    void MemoryAccount::begin()
+    {
+        this->id        = NEXT_ACCOUNT_ID.fetch_add(1, std::memory_order_relaxed);
+        this->usage     = {};
+        this->liveBytes = 0;
+        THREAD_USAGE    = {.owner = this->id};
+    }
+
+    void MemoryAccount::update()
+    {
+        auto& thread {THREAD_USAGE};
+        if (this->id != 0 and thread.owner == this->id)
+        {
+            auto peakBytes {std::max(this->liveBytes + thread.peakNetBytes, int64_t {0})};
+            this->usage.peakBytes = std::max(this->usage.peakBytes, static_cast<uint64_t>(peakBytes));
+            this->liveBytes += thread.netBytes;
+            this->usage.allocatedBytes += thread.allocatedBytes;
+            this->usage.allocations += thread.allocations;
+        }
+        thread = {.owner = this->id};
+    }
+} // namespace lily::crypto
@@ -0,0 +1,136 @@
+#include <atomic>
+#include <fmt/core.h>
+#include <memory>
+#include <oqs/oqs.h>
+#include <spdlog/spdlog.h>
+#include <string_view>
+#include <unordered_map>
+
+#include <lily/crypto/OQSDescriptorCache.h>
+
+using namespace lily::core;
+
+// The original constructors and destructors of the descriptors
+extern "C"
+{
+    OQS_KEM* __real_OQS_KEM_new(char const* methodName);
+    void __real_OQS_KEM_free(OQS_KEM* kem);
+    OQS_SIG* __real_OQS_SIG_new(char const* methodName);
+    void __real_OQS_SIG_free(OQS_SIG* sig);
+}
+
+namespace lily::crypto
+{
+    /**
+     * @brief The descriptors of every enabled algorithm, keyed by the names owned by liboqs. Immutable once built.
+     */
+    struct DescriptorCache
+    {
+        std::unordered_map<std::string_view, OQS_KEM*> kems {};
+        std::unordered_map<std::string_view, OQS_SIG*> sigs {};
+    };
+
+    // Never destroyed, as the keys still held by OpenSSL at exit release their descriptors through the cache
+    static std::atomic<DescriptorCache const*> PUBLISHED_CACHE {nullptr};
+    static std::atomic_uint64_t CACHED_REQUESTS {};
+    static std::atomic_uint64_t ALLOCATED_REQUESTS {};
+
+    Expect<void> buildOQSDescriptorCache()
+    {
+        if (PUBLISHED_CACHE.load(std::memory_order_acquire) != nullptr)
+            return success;
+
+        auto cache {std::make_unique<DescriptorCache>()};
+        for (int i {}; i < OQS_KEM_alg_count(); ++i)
+        {
+            auto* name {OQS_KEM_alg_identifier(i)};
+            if (!OQS_KEM_alg_is_enabled(name))
+                continue;
+            auto* kem {__real_OQS_KEM_new(name)};
+            if (kem == nullptr)
+            {
+                spdlog::error("Failed to create the descriptor of the KEM `{}`. Cause: OQS_KEM_new", name);
+                return ErrorCode::LILY_ERRORCODE_EXPECTED;
+            }
+            cache->kems.emplace(kem->method_name, kem);
+        }
+        for (int i {}; i < OQS_SIG_alg_count(); ++i)
+        {
+            auto* name {OQS_SIG_alg_identifier(i)};
+            if (!OQS_SIG_alg_is_enabled(name))
+                continue;
+            auto* sig {__real_OQS_SIG_new(name)};
+            if (sig == nullptr)
+            {
+                spdlog::error("Failed to create the descriptor of the signature `{}`. Cause: OQS_SIG_new", name);
+                return ErrorCode::LILY_ERRORCODE_EXPECTED;
+            }
+            cache->sigs.emplace(sig->method_name, sig);
+        }
+
+        fmt::print("[-] Cached the descriptors of {} KEM and {} signature algorithms\r\n", cache->kems.size(),
+                   cache->sigs.size());
+        PUBLISHED_CACHE.store(cache.release(), std::memory_order_release);
+        return success;
+    }
+
+    OQSDescriptorCounts getOQSDescriptorCounts()
+    {
+        return {.cached    = CACHED_REQUESTS.load(std::memory_order_relaxed),
+                .allocated = ALLOCATED_REQUESTS.load(std::memory_order_relaxed)};
+    }
+
+    // Returns the cached descriptor of an algorithm, if any
+    template<typename Descriptor>
+    static Descriptor* find(std::unordered_map<std::string_view, Descriptor*> DescriptorCache::*descriptors,
+                            char const* methodName)
+    {
+        auto const* cache {PUBLISHED_CACHE.load(std::memory_order_acquire)};
+        if (cache == nullptr or methodName == nullptr)
+            return nullptr;
+        auto it {(cache->*descriptors).find(methodName)};
+        return it == (cache->*descriptors).end() ? nullptr : it->second;
+    }
+
+    // Returns the cached descriptor of an algorithm, or allocates a new one
+    template<typename Descriptor, typename Allocate>
+    static Descriptor* request(std::unordered_map<std::string_view, Descriptor*> DescriptorCache::*descriptors,
+                               char const* methodName, Allocate allocate)
+    {
+        if (auto* descriptor {find(descriptors, methodName)})
+        {
+            CACHED_REQUESTS.fetch_add(1, std::memory_order_relaxed);
+            return descriptor;
+        }
+        ALLOCATED_REQUESTS.fetch_add(1, std::memory_order_relaxed);
+        return allocate(methodName);
+    }
+} // namespace lily::crypto
+
+// The wrappers the linker redirects every call to, a cached descriptor is never freed
+extern "C"
+{
+    OQS_KEM* __wrap_OQS_KEM_new(char const* methodName)
+    {
+        return lily::crypto::request(&lily::crypto::DescriptorCache::kems, methodName, __real_OQS_KEM_new);
+    }
+
+    void __wrap_OQS_KEM_free(OQS_KEM* kem)
+    {
+        if (kem != nullptr and lily::crypto::find(&lily::crypto::DescriptorCache::kems, kem->method_name) == kem)
+            return;
+        __real_OQS_KEM_free(kem);
+    }
+
+    OQS_SIG* __wrap_OQS_SIG_new(char const* methodName)
+    {
+        return lily::crypto::request(&lily::crypto::DescriptorCache::sigs, methodName, __real_OQS_SIG_new);
+    }
+
+    void __wrap_OQS_SIG_free(OQS_SIG* sig)
+    {
+        if (sig != nullptr and lily::crypto::find(&lily::crypto::DescriptorCache::sigs, sig->method_name) == sig)
+            return;
+        __real_OQS_SIG_free(sig);
+    }
+}
@@ -0,0 +1,111 @@
+#include <atomic>
+#include <oqs/oqs.h>
+
+#include <lily/crypto/KeysharePool.h>
+#include <lily/crypto/OQSHooks.h>
+
+namespace lily::crypto
+{
+    static std::atomic<OQSTimingHook> TIMING_HOOK {nullptr};
+
+    void setOQSTimingHook(OQSTimingHook hook)
+    {
+        TIMING_HOOK.store(hook, std::memory_order_release);
+    }
+
+    char const* getOQSOperationName(OQSOperation operation)
+    {
+        switch (operation)
+        {
+        case OQSOperation::KEM_KEYPAIR:
+            return "keypair";
+        case OQSOperation::KEM_ENCAPS:
+            return "encaps";
+        case OQSOperation::KEM_DECAPS:
+            return "decaps";
+        case OQSOperation::SIG_SIGN:
+            return "sign";
+        case OQSOperation::SIG_VERIFY:
+            return "verify";
+        }
+        return "unknown";
+    }
+
+    // Run a primitive, and report its duration to the installed hook
+    template <typename Primitive>
+    static OQS_STATUS time(OQSOperation operation, char const* algorithm, Primitive&& primitive)
+    {
+        auto hook {TIMING_HOOK.load(std::memory_order_acquire)};
+        if (hook == nullptr)
+            return primitive();
+
+        auto beginTime {std::chrono::steady_clock::now()};
+        auto status {primitive()};
+        hook(operation, algorithm, std::chrono::steady_clock::now() - beginTime);
+        return status;
+    }
+} // namespace lily::crypto
+
+// The original primitives, and the wrappers the linker redirects every call to
+extern "C"
+{
+    OQS_STATUS __real_OQS_KEM_keypair(OQS_KEM const* kem, uint8_t* publicKey, uint8_t* secretKey);
+    OQS_STATUS __real_OQS_KEM_encaps(OQS_KEM const* kem, uint8_t* ciphertext, uint8_t* sharedSecret,
+                                     uint8_t const* publicKey);
+    OQS_STATUS __real_OQS_KEM_decaps(OQS_KEM const* kem, uint8_t* sharedSecret, uint8_t const* ciphertext,
+                                     uint8_t const* secretKey);
+    OQS_STATUS __real_OQS_SIG_sign(OQS_SIG const* sig, uint8_t* signature, size_t* signatureLength,
+                                   uint8_t const* message, size_t messageLength, uint8_t const* secretKey);
+    OQS_STATUS __real_OQS_SIG_verify(OQS_SIG const* sig, uint8_t const* message, size_t messageLength,
+                                     uint8_t const* signature, size_t signatureLength, uint8_t const* publicKey);
+
+    OQS_STATUS __wrap_OQS_KEM_keypair(OQS_KEM const* kem, uint8_t* publicKey, uint8_t* secretKey)
+    {
+        if (kem == nullptr)
+            return __real_OQS_KEM_keypair(kem, publicKey, secretKey);
+
+        // A key pair taken from the pool costs no generation, only the misses are timed
+        if (lily::crypto::KeysharePool::getInstance().take(kem, publicKey, secretKey))
+            return OQS_SUCCESS;
+        return lily::crypto::time(lily::crypto::OQSOperation::KEM_KEYPAIR, kem->method_name,
+                                  [&] { return __real_OQS_KEM_keypair(kem, publicKey, secretKey); });
+    }
+
+    OQS_STATUS __wrap_OQS_KEM_encaps(OQS_KEM const* kem, uint8_t* ciphertext, uint8_t* sharedSecret,
+                                     uint8_t const* publicKey)
+    {
+        if (kem == nullptr)
+            return __real_OQS_KEM_encaps(kem, ciphertext, sharedSecret, publicKey);
+        return lily::crypto::time(lily::crypto::OQSOperation::KEM_ENCAPS, kem->method_name,
+                                  [&] { return __real_OQS_KEM_encaps(kem, ciphertext, sharedSecret, publicKey); });
+    }
+
+    OQS_STATUS __wrap_OQS_KEM_decaps(OQS_KEM const* kem, uint8_t* sharedSecret, uint8_t const* ciphertext,
+                                     uint8_t const* secretKey)
+    {
+        if (kem == nullptr)
+            return __real_OQS_KEM_decaps(kem, sharedSecret, ciphertext, secretKey);
+        return lily::crypto::time(lily::crypto::OQSOperation::KEM_DECAPS, kem->method_name,
+                                  [&] { return __real_OQS_KEM_decaps(kem, sharedSecret, ciphertext, secretKey); });
+    }
+
+    OQS_STATUS __wrap_OQS_SIG_sign(OQS_SIG const* sig, uint8_t* signature, size_t* signatureLength,
+                                   uint8_t const* message, size_t messageLength, uint8_t const* secretKey)
+    {
+        if (sig == nullptr)
+            return __real_OQS_SIG_sign(sig, signature, signatureLength, message, messageLength, secretKey);
+        return lily::crypto::time(
+            lily::crypto::OQSOperation::SIG_SIGN, sig->method_name,
+            [&] { return __real_OQS_SIG_sign(sig, signature, signatureLength, message, messageLength, secretKey); });
+    }
+
+    OQS_STATUS __wrap_OQS_SIG_verify(OQS_SIG const* sig, uint8_t const* message, size_t messageLength,
+                                     uint8_t const* signature, size_t signatureLength, uint8_t const* publicKey)
+    {
+        if (sig == nullptr)
+            return __real_OQS_SIG_verify(sig, message, messageLength, signature, signatureLength, publicKey);
+        return lily::crypto::time(
+            lily::crypto::OQSOperation::SIG_VERIFY, sig->method_name,
+            [&] { return __real_OQS_SIG_verify(sig, message, messageLength, signature, signatureLength, publicKey); });
+    }
+}
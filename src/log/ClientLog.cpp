@@ -1,4 +1,5 @@
 #include <fmt/chrono.h>
+#include <iterator>
 #include <spdlog/spdlog.h>
 
 #include <lily/log/ClientLog.h>
@@ -17,7 +18,11 @@ namespace lily::log
             std::exit(EXIT_FAILURE);
         }
         static constexpr std::string_view HEADER {
-            "hs_duration_us;write_size;write_duration_us;recv_size;recv_duration_us\r\n"};
+            "conn_id;hs_duration_us;write_size;write_duration_us;recv_size;recv_duration_us;resumed;"
+            "start_delay_us;latency_us;hs_bytes_sent;hs_bytes_recv;hs_records_sent;hs_records_recv;hs_flights;rtt_us;"
+            "retransmits;hs_mem_bytes;hs_mem_peak;hs_mem_allocs;hs_cycles;hs_instructions;hs_cache_misses;"
+            "hs_branch_misses;write_cycles;write_instructions;write_cache_misses;write_branch_misses;recv_cycles;"
+            "recv_instructions;recv_cache_misses;recv_branch_misses;ktls_send;ktls_recv\r\n"};
         this->stream.write(HEADER.data(), HEADER.size());
         this->stream.flush();
     }
@@ -28,13 +33,33 @@ namespace lily::log
         return instance;
     }
 
-    void ClientLog::write(int64_t hsDurationUs, uint64_t writeSize, int64_t writeDurationUs, uint64_t recvSize,
-                          int64_t recvDurationUs)
+    void ClientLog::write(Record const& record)
     {
-        auto log {
-            fmt::format("{};{};{};{};{}\r\n", hsDurationUs, writeSize, writeDurationUs, recvSize, recvDurationUs)};
-        std::lock_guard lock {this->mtx};
-        this->stream.write(log.c_str(), log.size());
-        this->stream.flush();
+        if (record.hsDurationUs >= 0)
+            this->latency.record(LatencyRecorder::Metric::HANDSHAKE, record.hsDurationUs);
+        this->latency.record(LatencyRecorder::Metric::WRITE, record.writeDurationUs);
+        this->latency.record(LatencyRecorder::Metric::READ, record.recvDurationUs);
+        this->latency.record(LatencyRecorder::Metric::TOTAL, record.latencyUs);
+
+        this->buffer.write(record);
+    }
+
+    void ClientLog::format(fmt::memory_buffer& out, Record const& record)
+    {
+        fmt::format_to(std::back_inserter(out), "{};{};{};{};{};{};{:d};{};{};{};{};{};{};{};{};{};{};{};{};",
+                       record.connId, record.hsDurationUs, record.writeSize, record.writeDurationUs, record.recvSize,
+                       record.recvDurationUs, record.resumed, record.startDelayUs, record.latencyUs,
+                       record.hsBytesSent, record.hsBytesRecv, record.hsRecordsSent, record.hsRecordsRecv,
+                       record.hsFlights, record.rttUs, record.retransmits, record.hsMemBytes, record.hsMemPeak,
+                       record.hsMemAllocs);
+        formatPerfCounts(out, record.hsPerf);
+        formatPerfCounts(out, record.writePerf);
+        formatPerfCounts(out, record.recvPerf);
+        fmt::format_to(std::back_inserter(out), "{:d};{:d}\r\n", record.ktlsSend, record.ktlsRecv);
+    }
+
+    void ClientLog::dumpHistograms(LatencyRecorder::Snapshot const& snapshot)
+    {
+        LatencyRecorder::dump(snapshot, fmt::format("{:%F_%T}_histogram_client.csv", fmt::localtime(BOOTSTRAP_TIME)));
     }
 } // namespace lily::log
@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#include <lily/log/Histogram.h>
+
+namespace lily::log
+{
+    std::size_t Histogram::bucketOf(uint64_t value)
+    {
+        value = std::min(value, MAX_VALUE);
+
+        // The values below two halves map one to one, the rest keep their `SUB_BUCKET_BITS` highest bits
+        if (value < 2 * SUB_BUCKET_HALF_COUNT)
+            return static_cast<std::size_t>(value);
+        auto shift {static_cast<std::size_t>(std::bit_width(value)) - SUB_BUCKET_BITS};
+        return shift * SUB_BUCKET_HALF_COUNT + static_cast<std::size_t>(value >> shift);
+    }
+
+    uint64_t Histogram::highestValueOf(std::size_t bucket)
+    {
+        if (bucket < 2 * SUB_BUCKET_HALF_COUNT)
+            return bucket;
+        auto shift {bucket / SUB_BUCKET_HALF_COUNT - 1};
+        auto subBucket {uint64_t {bucket % SUB_BUCKET_HALF_COUNT + SUB_BUCKET_HALF_COUNT}};
+        return ((subBucket + 1) << shift) - 1;
+    }
+
+    void Histogram::record(uint64_t value, uint64_t count)
+    {
+        this->add(bucketOf(value), count);
+    }
+
+    void Histogram::add(std::size_t bucket, uint64_t count)
+    {
+        this->counts[bucket] += count;
+        this->totalCount += count;
+    }
+
+    Histogram& Histogram::operator+=(Histogram const& other)
+    {
+        for (std::size_t i {}; i < BUCKET_COUNT; ++i)
+            this->counts[i] += other.counts[i];
+        this->totalCount += other.totalCount;
+        return *this;
+    }
+
+    Histogram& Histogram::operator-=(Histogram const& other)
+    {
+        for (std::size_t i {}; i < BUCKET_COUNT; ++i)
+            this->counts[i] -= std::min(this->counts[i], other.counts[i]);
+        this->totalCount -= std::min(this->totalCount, other.totalCount);
+        return *this;
+    }
+
+    uint64_t Histogram::percentile(double percentage) const
+    {
+        if (this->totalCount == 0)
+            return 0;
+
+        // The rank of the requested value, counted from one
+        auto rank {static_cast<uint64_t>(std::ceil(percentage / 100.0 * static_cast<double>(this->totalCount)))};
+        rank = std::clamp<uint64_t>(rank, 1, this->totalCount);
+
+        uint64_t cumulative {};
+        for (std::size_t i {}; i < BUCKET_COUNT; ++i)
+        {
+            cumulative += this->counts[i];
+            if (cumulative >= rank)
+                return highestValueOf(i);
+        }
+        return this->max();
+    }
+
+    uint64_t Histogram::max() const
+    {
+        for (auto i {BUCKET_COUNT}; i > 0; --i)
+            if (this->counts[i - 1] > 0)
+                return highestValueOf(i - 1);
+        return 0;
+    }
+} // namespace lily::log
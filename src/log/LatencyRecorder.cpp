@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <fmt/core.h>
+#include <fstream>
+#include <spdlog/spdlog.h>
+#include <utility>
+
+#include <lily/log/LatencyRecorder.h>
+
+namespace lily::log
+{
+    LatencyRecorder::LocalShards::~LocalShards()
+    {
+        for (auto [owner, shard]: this->shards)
+            shard->released.store(true, std::memory_order_release);
+    }
+
+    LatencyRecorder::Shard& LatencyRecorder::localShard()
+    {
+        // A thread may record into more than one recorder, so the shards are looked up by their owner
+        thread_local LocalShards localShards {};
+        for (auto [owner, shard]: localShards.shards)
+            if (owner == this)
+                return *shard;
+
+        // The threads of every run reuse the shards of the previous ones, so their number stays bounded
+        std::lock_guard lock {this->mtx};
+        auto reused {std::ranges::find_if(this->shards, [](auto const& shard)
+                                          { return shard->released.load(std::memory_order_acquire); })};
+        auto* shard {reused != this->shards.end() ? reused->get()
+                                                  : this->shards.emplace_back(std::make_unique<Shard>()).get()};
+        shard->released.store(false, std::memory_order_relaxed);
+        localShards.shards.emplace_back(this, shard);
+        return *shard;
+    }
+
+    void LatencyRecorder::record(Metric metric, int64_t latencyUs)
+    {
+        auto bucket {Histogram::bucketOf(static_cast<uint64_t>(std::max<int64_t>(latencyUs, 0)))};
+        this->localShard().counts[static_cast<std::size_t>(metric)][bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::unique_ptr<LatencyRecorder::Snapshot> LatencyRecorder::snapshot() const
+    {
+        auto merged {std::make_unique<Snapshot>()};
+        std::lock_guard lock {this->mtx};
+        for (auto const& shard: this->shards)
+            for (std::size_t metric {}; metric < METRIC_COUNT; ++metric)
+                for (std::size_t bucket {}; bucket < Histogram::BUCKET_COUNT; ++bucket)
+                    if (auto count {shard->counts[metric][bucket].load(std::memory_order_relaxed)}; count > 0)
+                        (*merged)[metric].add(bucket, count);
+        return merged;
+    }
+
+    std::unique_ptr<LatencyRecorder::Snapshot> LatencyRecorder::collect()
+    {
+        auto current {this->snapshot()};
+        auto interval {std::make_unique<Snapshot>(*current)};
+
+        std::lock_guard lock {this->mtx};
+        for (std::size_t metric {}; metric < METRIC_COUNT; ++metric)
+            (*interval)[metric] -= (*this->lastSnapshot)[metric];
+        this->lastSnapshot = std::move(current);
+        return interval;
+    }
+
+    void LatencyRecorder::print(Snapshot const& snapshot)
+    {
+        for (std::size_t metric {}; metric < METRIC_COUNT; ++metric)
+        {
+            auto const& histogram {snapshot[metric]};
+            if (histogram.count() == 0)
+                continue;
+            fmt::print("[-] {:<9} | p50: {} us | p90: {} us | p99: {} us | p99.9: {} us | max: {} us | n: {}\r\n",
+                       METRIC_NAMES[metric], histogram.percentile(50.0), histogram.percentile(90.0),
+                       histogram.percentile(99.0), histogram.percentile(99.9), histogram.max(), histogram.count());
+        }
+    }
+
+    void LatencyRecorder::dump(Snapshot const& snapshot, std::filesystem::path const& path)
+    {
+        std::ofstream stream {path};
+        if (!stream.is_open())
+            return spdlog::error("Failed to create latency histogram file {}", path.string());
+
+        // Every row counts the values up to and including `value_us`, above the value of the previous bucket
+        stream << "metric;value_us;count\r\n";
+        for (std::size_t metric {}; metric < METRIC_COUNT; ++metric)
+            for (std::size_t bucket {}; bucket < Histogram::BUCKET_COUNT; ++bucket)
+                if (auto count {snapshot[metric].countAt(bucket)}; count > 0)
+                    stream << fmt::format("{};{};{}\r\n", METRIC_NAMES[metric], Histogram::highestValueOf(bucket),
+                                          count);
+    }
+} // namespace lily::log
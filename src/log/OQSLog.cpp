@@ -0,0 +1,35 @@
+#include <fmt/chrono.h>
+#include <iterator>
+#include <spdlog/spdlog.h>
+
+#include <lily/log/OQSLog.h>
+
+namespace lily::log
+{
+    static auto BOOTSTRAP_TIME {std::time(nullptr)};
+
+    OQSLog::OQSLog()
+    {
+        //
+        this->stream.open(fmt::format("{:%F_%T}_log_oqs.csv", fmt::localtime(BOOTSTRAP_TIME)));
+        if (!this->stream.is_open())
+        {
+            spdlog::error("Failed to create liboqs record log");
+            std::exit(EXIT_FAILURE);
+        }
+        static constexpr std::string_view HEADER {"operation;algorithm;duration_ns\r\n"};
+        this->stream.write(HEADER.data(), HEADER.size());
+        this->stream.flush();
+    }
+
+    OQSLog& OQSLog::getInstance()
+    {
+        static OQSLog instance {};
+        return instance;
+    }
+
+    void OQSLog::format(fmt::memory_buffer& out, Record const& record)
+    {
+        fmt::format_to(std::back_inserter(out), "{};{};{}\r\n", record.operation, record.algorithm, record.durationNs);
+    }
+} // namespace lily::log
@@ -0,0 +1,203 @@
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <linux/perf_event.h>
+#include <spdlog/spdlog.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <lily/log/PerfCounters.h>
+
+namespace lily::log
+{
+    // The generic hardware events, by `PerfEvent`
+    static constexpr std::array<uint64_t, PERF_EVENT_COUNT> EVENT_CONFIGS {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+    /**
+     * @brief The counts of a group, and how long it was enabled and actually counting on the PMU (in ns).
+     */
+    struct PerfSample
+    {
+        PerfCounts counts {};
+        uint64_t timeEnabled {};
+        uint64_t timeRunning {};
+    };
+
+    /**
+     * @brief The counter group of a thread, read at once, and the account that last read it.
+     */
+    struct ThreadCounters
+    {
+        std::array<int, PERF_EVENT_COUNT> fds {-1, -1, -1, -1};
+
+        // The id given by the kernel to every event of the group, zero for a missing event
+        std::array<uint64_t, PERF_EVENT_COUNT> ids {};
+        bool opened {};
+
+        // The id of the account owning the thread, and the counts of its last update
+        uint64_t owner {};
+        PerfSample snapshot {};
+
+        ThreadCounters() = default;
+
+        ThreadCounters(ThreadCounters const&)            = delete;
+        ThreadCounters& operator=(ThreadCounters const&) = delete;
+
+        ~ThreadCounters()
+        {
+            for (auto fd: this->fds)
+                if (fd >= 0)
+                    close(fd);
+        }
+
+        // Open the events of the group counting the calling thread, returns false when none can be counted
+        bool open()
+        {
+            this->opened = true;
+            for (std::size_t i {}; i < PERF_EVENT_COUNT; ++i)
+            {
+                perf_event_attr attr {};
+                attr.type           = PERF_TYPE_HARDWARE;
+                attr.size           = sizeof(attr);
+                attr.config         = EVENT_CONFIGS[i];
+                attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                                   PERF_FORMAT_TOTAL_TIME_RUNNING;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv     = 1;
+
+                // The first event opened leads the group, the missing ones are skipped
+                auto fd {static_cast<int>(
+                    syscall(SYS_perf_event_open, &attr, 0, -1, this->getLeader(), PERF_FLAG_FD_CLOEXEC))};
+                if (fd < 0)
+                    continue;
+                if (ioctl(fd, PERF_EVENT_IOC_ID, &this->ids[i]) < 0)
+                {
+                    close(fd);
+                    continue;
+                }
+                this->fds[i] = fd;
+            }
+            return this->getLeader() >= 0;
+        }
+
+        int getLeader() const
+        {
+            for (auto fd: this->fds)
+                if (fd >= 0)
+                    return fd;
+            return -1;
+        }
+
+        // Read the whole group with a single system call
+        bool read(PerfSample& sample)
+        {
+            if (!this->opened)
+                this->open();
+            auto leader {this->getLeader()};
+            if (leader < 0)
+                return false;
+
+            struct
+            {
+                uint64_t count;
+                uint64_t timeEnabled;
+                uint64_t timeRunning;
+                struct
+                {
+                    uint64_t value;
+                    uint64_t id;
+                } values[PERF_EVENT_COUNT];
+            } group {};
+            if (::read(leader, &group, sizeof(group)) < static_cast<ssize_t>(3 * sizeof(uint64_t)))
+                return false;
+
+            sample = {.timeEnabled = group.timeEnabled, .timeRunning = group.timeRunning};
+            for (uint64_t i {}; i < group.count and i < PERF_EVENT_COUNT; ++i)
+                for (std::size_t event {}; event < PERF_EVENT_COUNT; ++event)
+                    if (this->fds[event] >= 0 and this->ids[event] == group.values[i].id)
+                        sample.counts[event] = group.values[i].value;
+            return true;
+        }
+    };
+
+    static std::atomic_bool ENABLED {};
+    static std::atomic_uint64_t NEXT_ACCOUNT_ID {1};
+    static thread_local ThreadCounters THREAD_COUNTERS {};
+
+    bool enablePerfCounters()
+    {
+        // Probe on a group of our own, the calling thread opens its counters again on first use
+        ThreadCounters probe {};
+        PerfSample sample {};
+        if (!probe.open() or !probe.read(sample))
+        {
+            spdlog::warn("The hardware performance counters are not available ({}), every count is zero. Check "
+                         "`kernel.perf_event_paranoid` and whether the machine exposes a PMU",
+                         std::strerror(errno));
+            return false;
+        }
+        for (std::size_t i {}; i < PERF_EVENT_COUNT; ++i)
+            if (probe.fds[i] < 0)
+                spdlog::warn("The hardware event `{}` is not supported by the PMU, its count is zero",
+                             PERF_EVENT_NAMES[i]);
+        if (sample.timeRunning == 0)
+            spdlog::warn("The hardware performance counters are held by another user, such as the NMI watchdog, the "
+                         "events are only counted while the PMU schedules them");
+        ENABLED.store(true, std::memory_order_relaxed);
+        return true;
+    }
+
+    void formatPerfCounts(fmt::memory_buffer& out, PerfCounts const& counts)
+    {
+        for (auto count: counts)
+            fmt::format_to(std::back_inserter(out), "{};", count);
+    }
+
+    void PerfAccount::begin()
+    {
+        this->id       = NEXT_ACCOUNT_ID.fetch_add(1, std::memory_order_relaxed);
+        this->sections = {};
+        if (!ENABLED.load(std::memory_order_relaxed))
+            return;
+
+        auto& thread {THREAD_COUNTERS};
+        if (thread.read(thread.snapshot))
+            thread.owner = this->id;
+    }
+
+    void PerfAccount::reset(PerfSection section)
+    {
+        this->sections[static_cast<std::size_t>(section)] = {};
+    }
+
+    void PerfAccount::update(PerfSection section)
+    {
+        if (!ENABLED.load(std::memory_order_relaxed))
+            return;
+
+        auto& thread {THREAD_COUNTERS};
+        PerfSample sample {};
+        if (!thread.read(sample))
+            return;
+
+        // The PMU leaves the group out while its counters are held by others (the NMI watchdog, another perf user).
+        // Nothing is counted when it never ran since the last update, and it is scaled up when it only partly ran.
+        auto enabled {sample.timeEnabled - thread.snapshot.timeEnabled};
+        auto running {sample.timeRunning - thread.snapshot.timeRunning};
+        if (this->id != 0 and thread.owner == this->id and running > 0)
+        {
+            auto scale {static_cast<double>(enabled) / static_cast<double>(running)};
+            auto& total {this->sections[static_cast<std::size_t>(section)]};
+            for (std::size_t i {}; i < PERF_EVENT_COUNT; ++i)
+            {
+                auto count {sample.counts[i] - thread.snapshot.counts[i]};
+                total[i] += running < enabled ? static_cast<uint64_t>(static_cast<double>(count) * scale) : count;
+            }
+        }
+        thread.snapshot = sample;
+        thread.owner    = this->id;
+    }
+} // namespace lily::log
@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <fmt/chrono.h>
+#include <iterator>
 #include <spdlog/spdlog.h>
 
 #include <lily/log/ServerLog.h>
@@ -17,7 +19,11 @@ namespace lily::log
             std::exit(EXIT_FAILURE);
         }
         static constexpr std::string_view HEADER {
-            "hs_duration_us;recv_size;recv_duration_us;write_size;write_duration_us\r\n"};
+            "conn_id;hs_duration_us;recv_size;recv_duration_us;write_size;write_duration_us;resumed;hs_bytes_sent;"
+            "hs_bytes_recv;hs_records_sent;hs_records_recv;hs_flights;rtt_us;retransmits;hs_mem_bytes;hs_mem_peak;"
+            "hs_mem_allocs;hs_cycles;hs_instructions;hs_cache_misses;hs_branch_misses;recv_cycles;recv_instructions;"
+            "recv_cache_misses;recv_branch_misses;write_cycles;write_instructions;write_cache_misses;"
+            "write_branch_misses;ktls_send;ktls_recv\r\n"};
         this->stream.write(HEADER.data(), HEADER.size());
         this->stream.flush();
     }
@@ -28,13 +34,34 @@ namespace lily::log
         return instance;
     }
 
-    void ServerLog::write(int64_t hsDurationUs, uint64_t recvSize, int64_t recvDurationUs, uint64_t writeSize,
-                          int64_t writeDurationUs)
+    void ServerLog::write(Record const& record)
     {
-        auto log {
-            fmt::format("{};{};{};{};{}\r\n", hsDurationUs, recvSize, recvDurationUs, writeSize, writeDurationUs)};
-        std::lock_guard lock {this->mtx};
-        this->stream.write(log.c_str(), log.size());
-        this->stream.flush();
+        auto hsDurationUs {std::max(record.hsDurationUs, int64_t {0})};
+        if (record.hsDurationUs >= 0)
+            this->latency.record(LatencyRecorder::Metric::HANDSHAKE, hsDurationUs);
+        this->latency.record(LatencyRecorder::Metric::WRITE, record.writeDurationUs);
+        this->latency.record(LatencyRecorder::Metric::READ, record.recvDurationUs);
+        this->latency.record(LatencyRecorder::Metric::TOTAL,
+                             hsDurationUs + record.recvDurationUs + record.writeDurationUs);
+
+        this->buffer.write(record);
+    }
+
+    void ServerLog::format(fmt::memory_buffer& out, Record const& record)
+    {
+        fmt::format_to(std::back_inserter(out), "{};{};{};{};{};{};{:d};{};{};{};{};{};{};{};{};{};{};",
+                       record.connId, record.hsDurationUs, record.recvSize, record.recvDurationUs, record.writeSize,
+                       record.writeDurationUs, record.resumed, record.hsBytesSent, record.hsBytesRecv,
+                       record.hsRecordsSent, record.hsRecordsRecv, record.hsFlights, record.rttUs, record.retransmits,
+                       record.hsMemBytes, record.hsMemPeak, record.hsMemAllocs);
+        formatPerfCounts(out, record.hsPerf);
+        formatPerfCounts(out, record.recvPerf);
+        formatPerfCounts(out, record.writePerf);
+        fmt::format_to(std::back_inserter(out), "{:d};{:d}\r\n", record.ktlsSend, record.ktlsRecv);
+    }
+
+    void ServerLog::dumpHistograms(LatencyRecorder::Snapshot const& snapshot)
+    {
+        LatencyRecorder::dump(snapshot, fmt::format("{:%F_%T}_histogram_server.csv", fmt::localtime(BOOTSTRAP_TIME)));
     }
 } // namespace lily::log
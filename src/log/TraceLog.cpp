@@ -0,0 +1,39 @@
+#include <fmt/chrono.h>
+#include <iterator>
+#include <spdlog/spdlog.h>
+
+#include <lily/log/TraceLog.h>
+
+namespace lily::log
+{
+    static auto BOOTSTRAP_TIME {std::time(nullptr)};
+
+    TraceLog::TraceLog()
+    {
+        //
+        this->stream.open(fmt::format("{:%F_%T}_log_trace.csv", fmt::localtime(BOOTSTRAP_TIME)));
+        if (!this->stream.is_open())
+        {
+            spdlog::error("Failed to create handshake trace log");
+            std::exit(EXIT_FAILURE);
+        }
+        static constexpr std::string_view HEADER {"conn_id;client_hello_us;server_hello_us;encrypted_extensions_us;"
+                                                  "certificate_us;certificate_verify_us;server_finished_us;"
+                                                  "client_finished_us\r\n"};
+        this->stream.write(HEADER.data(), HEADER.size());
+        this->stream.flush();
+    }
+
+    TraceLog& TraceLog::getInstance()
+    {
+        static TraceLog instance {};
+        return instance;
+    }
+
+    void TraceLog::format(fmt::memory_buffer& out, Record const& record)
+    {
+        fmt::format_to(std::back_inserter(out), "{};{};{};{};{};{};{};{}\r\n", record.connId, record.clientHelloUs,
+                       record.serverHelloUs, record.encryptedExtensionsUs, record.certificateUs,
+                       record.certificateVerifyUs, record.serverFinishedUs, record.clientFinishedUs);
+    }
+} // namespace lily::log
@@ -1,57 +1,226 @@
 #include <CLI/CLI.hpp>
+#include <algorithm>
+#include <csignal>
 #include <cstdlib>
 #include <fmt/color.h>
 #include <fmt/core.h>
+#include <map>
+#include <spdlog/spdlog.h>
+#include <string_view>
 #include <thread>
 
+#include <lily/bench/CryptoBench.h>
+#include <lily/bench/DescriptorBench.h>
+#include <lily/bench/HandshakeBench.h>
+#include <lily/bench/Sweep.h>
 #include <lily/crypto/Key.h>
+#include <lily/crypto/KeysharePool.h>
+#include <lily/crypto/MemoryAccounting.h>
+#include <lily/crypto/OQSDescriptorCache.h>
+#include <lily/crypto/OQSHooks.h>
 #include <lily/crypto/OQSLoader.h>
-#include <lily/net/ClientConnection.h>
+#include <lily/log/ClientLog.h>
+#include <lily/log/OQSLog.h>
+#include <lily/log/PerfCounters.h>
+#include <lily/log/ServerLog.h>
+#include <lily/log/TraceLog.h>
+#include <lily/net/LoadGenerator.h>
 #include <lily/net/ServerListener.h>
 
+using namespace lily::bench;
 using namespace lily::core;
 using namespace lily::crypto;
+using namespace lily::log;
 using namespace lily::net;
 
 int32_t main(int32_t argc, char** argv)
 {
+    // OpenSSL only takes a new allocator before its first allocation, so the flag is looked up ahead of the CLI
+    auto isMemoryAccounting {[](char const* arg) { return std::string_view {arg} == "--memory-accounting"; }};
+    if (std::any_of(argv + 1, argv + argc, isMemoryAccounting) and !enableMemoryAccounting())
+        return EXIT_FAILURE;
+
     // Load OQS provider to OpenSSL
     if (!loadOQSProvider())
         return EXIT_FAILURE;
 
+    // Create the liboqs descriptors once, instead of once per key of every handshake
+    if (!buildOQSDescriptorCache())
+        return EXIT_FAILURE;
+
     // Main CLI commands
     CLI::App main {"Lily-PQC main commands"};
 
+    // The log options shared by the server and the client
+    BufferedLogConfig logConfig {};
+    uint32_t logFlushInterval {static_cast<uint32_t>(logConfig.flushInterval.count())};
+    bool oqsTiming {};
+    // Only parsed to be accepted, the memory accounting is enabled before the CLI
+    bool memoryAccounting {};
+    bool perfCounters {};
+    auto addLogOptions {
+        [&](CLI::App* command)
+        {
+            command->add_flag("--oqs-timing", oqsTiming,
+                              "Record the duration of every liboqs primitive call to the liboqs CSV log");
+            command->add_flag("--memory-accounting", memoryAccounting,
+                              "Account the heap allocated by OpenSSL and the oqs-provider during every handshake to "
+                              "the CSV log");
+            command->add_flag("--perf-counters", perfCounters,
+                              "Count the CPU cycles, instructions, cache misses and branch misses of the handshake, "
+                              "read and write of every request to the CSV log (Linux perf_event_open)");
+            command
+                ->add_option("--log-flush-interval-ms", logFlushInterval,
+                             "How often the buffered log records are written to the CSV log (in milliseconds)")
+                ->capture_default_str()
+                ->check(CLI::PositiveNumber);
+            command
+                ->add_option("--log-overflow", logConfig.overflow,
+                             "What a thread does when its log buffer is full: drop (and count) the record or block "
+                             "until it is written (default: drop)")
+                ->transform(CLI::CheckedTransformer(
+                    std::map<std::string, OverflowPolicy> {{"drop", OverflowPolicy::DROP},
+                                                           {"block", OverflowPolicy::BLOCK}},
+                    CLI::ignore_case));
+            command
+                ->add_option("--log-buffer-records", logConfig.bufferRecords,
+                             "The number of log records each thread can buffer between two flushes")
+                ->capture_default_str()
+                ->check(CLI::PositiveNumber);
+        }};
+    auto applyLogOptions {
+        [&](bool traceHandshake)
+        {
+            logConfig.flushInterval = std::chrono::milliseconds {logFlushInterval};
+            if (traceHandshake)
+                TraceLog::getInstance().configure(logConfig);
+
+            // Without the permission, the connections still run and every count is zero
+            if (perfCounters)
+                enablePerfCounters();
+            if (!oqsTiming)
+                return;
+
+            // Time the liboqs primitives into their own buffered log
+            OQSLog::getInstance().configure(logConfig);
+            setOQSTimingHook(
+                [](OQSOperation operation, char const* algorithm, std::chrono::nanoseconds duration)
+                {
+                    OQSLog::getInstance().write({.operation  = getOQSOperationName(operation),
+                                                 .algorithm  = algorithm,
+                                                 .durationNs = duration.count()});
+                });
+        }};
+    auto reportDroppedRecords {
+        [&](bool traceHandshake)
+        {
+            if (auto dropped {traceHandshake ? TraceLog::getInstance().getDroppedRecords() : 0}; dropped > 0)
+                spdlog::warn("{} trace log records were dropped because the log buffer was full", dropped);
+            if (auto dropped {oqsTiming ? OQSLog::getInstance().getDroppedRecords() : 0}; dropped > 0)
+                spdlog::warn("{} liboqs log records were dropped because the log buffer was full", dropped);
+        }};
+
+    // The TCP options shared by the server and the client
+    auto addSocketOptions {
+        [](CLI::App* command, SocketOptions& options)
+        {
+            command->add_flag("--tcp-nodelay", options.noDelay,
+                              "Disable Nagle's algorithm, so small records are sent without waiting for an ACK");
+            command
+                ->add_option("--linger", options.lingerSeconds,
+                             "Close the connections with this SO_LINGER timeout (in seconds), 0 aborts them with a "
+                             "reset and skips TIME_WAIT (default: regular close)")
+                ->check(CLI::NonNegativeNumber);
+            command->add_flag("--tcp-fastopen", options.fastOpen,
+                              "Use TCP Fast Open, carrying the ClientHello with the SYN once a cookie is granted "
+                              "(needs the net.ipv4.tcp_fastopen sysctl)");
+        }};
+
     // Handle `main run-server` execution
     auto mainRunServer {main.add_subcommand("server-run", "Run application as server")};
-    std::filesystem::path certificateFile {};
-    std::filesystem::path privateKeyFile {};
-    uint16_t port {};
+    ServerConfig serverConfig {.workerThreads = std::max(std::thread::hardware_concurrency(), 1u)};
+    uint32_t sessionTicketLifetime {static_cast<uint32_t>(serverConfig.sessionTicketLifetime.count())};
     {
         mainRunServer
-            ->add_option("--certificate-file", certificateFile,
-                         "The absolute path to the server's certificate file, in PEM format")
+            ->add_option("--certificate-file", serverConfig.certificatePaths,
+                         "The absolute path to the server's certificate file, in PEM format. Repeat it to serve "
+                         "several certificates, selected per handshake by the client signature algorithms and SNI")
             ->required()
             ->check(CLI::ExistingFile);
         mainRunServer
-            ->add_option("--private-key-file", privateKeyFile,
-                         "The absolute path to the server's private key file, in PEM format")
+            ->add_option("--private-key-file", serverConfig.privateKeyPaths,
+                         "The absolute path to the server's private key file, in PEM format. Repeat it once per "
+                         "certificate, in the same order")
             ->required()
             ->check(CLI::ExistingFile);
-        mainRunServer->add_option("--port", port, "The server listener port")->required()->check(CLI::PositiveNumber);
+        mainRunServer->add_option("--port", serverConfig.port, "The server listener port")
+            ->required()
+            ->check(CLI::PositiveNumber);
+        mainRunServer
+            ->add_option("--worker-threads", serverConfig.workerThreads,
+                         "The number of threads serving the connections (default: number of CPU cores)")
+            ->capture_default_str()
+            ->check(CLI::PositiveNumber);
+        mainRunServer
+            ->add_option("--acceptor-shards", serverConfig.acceptorShards,
+                         "The number of acceptors opened on the port with SO_REUSEPORT, each with its own io_context")
+            ->capture_default_str()
+            ->check(CLI::PositiveNumber);
+        mainRunServer
+            ->add_option("--session-tickets", serverConfig.sessionTickets,
+                         "The number of TLS 1.3 session tickets issued after a full handshake, 0 disables resumption")
+            ->capture_default_str()
+            ->check(CLI::NonNegativeNumber);
+        mainRunServer
+            ->add_option("--session-ticket-lifetime", sessionTicketLifetime,
+                         "The lifetime of the issued session tickets (in seconds)")
+            ->capture_default_str()
+            ->check(CLI::PositiveNumber);
+        mainRunServer
+            ->add_option("--crypto-threads", serverConfig.cryptoThreads,
+                         "The number of threads running the TLS handshakes off the I/O threads, 0 runs them inline")
+            ->capture_default_str()
+            ->check(CLI::NonNegativeNumber);
+        mainRunServer->add_flag("--trace-handshake", serverConfig.traceHandshake,
+                                "Record the time of every handshake message to the trace log");
+        mainRunServer->add_flag("--enable-control", serverConfig.enableControl,
+                                "Let the clients replace the served certificate, as `sweep` does (test benches only)");
+        mainRunServer->add_option("--cert-compression", serverConfig.certCompression,
+                                  "The colon-separated certificate compression algorithms offered, in order of "
+                                  "preference, among zlib, brotli and zstd (default: none)");
+        mainRunServer
+            ->add_option("--max-record-size", serverConfig.maxRecordSize,
+                         "The largest plaintext sent in a single TLS record (in bytes, default: 16384)")
+            ->check(CLI::Range(512, 16384));
+        mainRunServer->add_flag("--ktls", serverConfig.ktls,
+                                "Let the kernel encrypt and decrypt the records once the handshake completes (kTLS, "
+                                "Linux only), falling back to OpenSSL when the kernel cannot");
+        addSocketOptions(mainRunServer, serverConfig.socketOptions);
+        addLogOptions(mainRunServer);
         mainRunServer->callback(
             [&]
             {
+                applyLogOptions(serverConfig.traceHandshake);
+                ServerLog::getInstance().configure(logConfig);
+
+                // OpenSSL writes the kTLS sockets without `MSG_NOSIGNAL`, a peer closing early must not kill the server
+                if (serverConfig.ktls)
+                    std::signal(SIGPIPE, SIG_IGN);
+
                 // Initialize the server with its configuration
-                auto outcomeListener {ServerListener::create(port, certificateFile, privateKeyFile)};
+                serverConfig.sessionTicketLifetime = std::chrono::seconds {sessionTicketLifetime};
+                auto outcomeListener {ServerListener::create(serverConfig)};
                 if (!outcomeListener)
                     return std::exit(EXIT_FAILURE);
                 auto listener {std::move(outcomeListener.assume_value())};
 
-                fmt::print(fmt::fg(fmt::color::green), "[v] Listening to port {}...\r\n", port);
+                fmt::print(fmt::fg(fmt::color::green),
+                           "[v] Listening to port {} with {} worker threads and {} acceptor shards...\r\n",
+                           serverConfig.port, serverConfig.workerThreads, serverConfig.acceptorShards);
 
                 // Listen to the given port
                 listener.run();
+                reportDroppedRecords(serverConfig.traceHandshake);
             });
     }
 
@@ -91,73 +260,296 @@ int32_t main(int32_t argc, char** argv)
 
     // Handle `main run-client` execution
     auto mainRunClient {main.add_subcommand("client-run", "Run application as client")};
-    std::string serverHost {};
-    uint16_t serverPort {};
-    uint32_t concurrentNum {};
-    std::string tlsGroup {};
-    uint32_t dummyDataLength {};
+    LoadConfig loadConfig {.clientThreads = std::max(std::thread::hardware_concurrency(), 1u)};
+    uint32_t loadDuration {};
+    uint32_t keysharePool {};
+    uint32_t keysharePoolThreads {1};
     {
-        mainRunClient->add_option("--server-host", serverHost, "The server host address (eg, 192.168.1.2)")
+        mainRunClient
+            ->add_option("--server-host", loadConfig.client.serverHost, "The server host address (eg, 192.168.1.2)")
             ->required()
             ->check(CLI::TypeValidator<std::string> {});
-        mainRunClient->add_option("--server-port", serverPort, "The server host port (eg, 7004)")
+        mainRunClient->add_option("--server-port", loadConfig.client.serverPort, "The server host port (eg, 7004)")
             ->required()
             ->check(CLI::PositiveNumber);
-        mainRunClient->add_option("--concurrent-user", concurrentNum, "The number of concurrent user")
+        mainRunClient->add_option("--concurrent-user", loadConfig.concurrentUsers, "The number of concurrent user")
             ->required()
             ->check(CLI::PositiveNumber);
-        mainRunClient->add_option("--tls-group", tlsGroup, "The TLS group used")
+        mainRunClient
+            ->add_option("--client-threads", loadConfig.clientThreads,
+                         "The number of threads running the concurrent users (default: number of CPU cores)")
+            ->capture_default_str()
+            ->check(CLI::PositiveNumber);
+        mainRunClient->add_option("--tls-group", loadConfig.client.tlsGroup, "The TLS group used")
             ->required()
             ->check(CLI::TypeValidator<std::string> {});
         mainRunClient
-            ->add_option("--data-length", dummyDataLength, "The size of the data to be transmitted to the server (in bytes)")
+            ->add_option("--data-length", loadConfig.client.dummyDataLength,
+                         "The size of the data to be transmitted to the server (in bytes)")
             ->required()
             ->check(CLI::PositiveNumber);
+        mainRunClient
+            ->add_option("--resumption-ratio", loadConfig.client.resumptionRatio,
+                         "The fraction of requests resuming the previous TLS session of the user (0.0 to 1.0)")
+            ->capture_default_str()
+            ->check(CLI::Range(0.0, 1.0));
+        mainRunClient
+            ->add_option("--rate", loadConfig.rate,
+                         "Send requests at this fixed rate (in req/s) instead of back-to-back, with the concurrent "
+                         "users bounding the requests in flight (default: 0, disabled)")
+            ->check(CLI::NonNegativeNumber);
+        mainRunClient
+            ->add_option("--arrival", loadConfig.arrival,
+                         "The arrival process of the requests sent with --rate: constant or poisson "
+                         "(default: constant)")
+            ->transform(CLI::CheckedTransformer(
+                std::map<std::string, ArrivalProcess> {{"constant", ArrivalProcess::CONSTANT},
+                                                       {"poisson", ArrivalProcess::POISSON}},
+                CLI::ignore_case));
+        mainRunClient
+            ->add_option("--duration-s", loadDuration,
+                         "Stop the users after this many seconds (default: 0, run until interrupted)")
+            ->check(CLI::NonNegativeNumber);
+        mainRunClient
+            ->add_option("--requests", loadConfig.requestLimit,
+                         "Stop the users after this many completed requests (default: 0, no limit)")
+            ->check(CLI::NonNegativeNumber);
+        mainRunClient->add_flag("--trace-handshake", loadConfig.client.traceHandshake,
+                                "Record the time of every handshake message to the trace log");
+        mainRunClient->add_option("--cert-compression", loadConfig.client.certCompression,
+                                  "The colon-separated certificate compression algorithms accepted, in order of "
+                                  "preference, among zlib, brotli and zstd (default: none)");
+        mainRunClient->add_flag("--throughput", loadConfig.client.keepAlive,
+                                "Keep the connection of every user alive and send all its requests over it, to "
+                                "measure the record layer throughput instead of the handshakes");
+        mainRunClient
+            ->add_option("--cipher-suite", loadConfig.client.cipherSuites,
+                         "Force the TLS 1.3 cipher suite: aes-128-gcm, aes-256-gcm or chacha20 (default: negotiated)")
+            ->transform(CLI::CheckedTransformer(
+                std::map<std::string, std::string> {{"aes-128-gcm", "TLS_AES_128_GCM_SHA256"},
+                                                    {"aes-256-gcm", "TLS_AES_256_GCM_SHA384"},
+                                                    {"chacha20", "TLS_CHACHA20_POLY1305_SHA256"}},
+                CLI::ignore_case));
+        mainRunClient
+            ->add_option("--max-record-size", loadConfig.client.maxRecordSize,
+                         "The largest plaintext sent in a single TLS record (in bytes, default: 16384)")
+            ->check(CLI::Range(512, 16384));
+        mainRunClient->add_flag("--ktls", loadConfig.client.ktls,
+                                "Let the kernel encrypt and decrypt the records once the handshake completes (kTLS, "
+                                "Linux only), falling back to OpenSSL when the kernel cannot");
+        addSocketOptions(mainRunClient, loadConfig.client.socketOptions);
+        mainRunClient->add_option("--source-address", loadConfig.client.sourceAddresses,
+                                  "A local address the connections are bound to, repeat it to spread them across "
+                                  "several addresses and their ephemeral port ranges (default: picked by the kernel)");
+        mainRunClient
+            ->add_option("--keyshare-pool", keysharePool,
+                         "Pre-generate up to this many KEM key pairs per group in the background, taken by the "
+                         "handshakes instead of generating their own (load generation only, default: 0, disabled)")
+            ->check(CLI::NonNegativeNumber);
+        mainRunClient
+            ->add_option("--keyshare-pool-threads", keysharePoolThreads,
+                         "The number of threads generating the key pairs of the keyshare pool")
+            ->capture_default_str()
+            ->check(CLI::PositiveNumber);
+        addLogOptions(mainRunClient);
         mainRunClient->callback(
             [&]
             {
-                // Record total request
-                std::atomic_int64_t totalSuccessfulRequest {};
-                std::atomic_int64_t totalFailedRequest {};
-
-                // Set-up concurrent users pool
-                std::vector<std::jthread> userThreads(concurrentNum);
-                for (auto& thread: userThreads)
-                    thread = std::jthread {
-                        [&]
-                        {
-                            // Send dummy data repeatedly
-                            while (true)
-                            {
-                                if (!ClientConnection::sendDummyData(serverHost, serverPort, tlsGroup, dummyDataLength))
-                                    ++totalFailedRequest;
-                                else
-                                    ++totalSuccessfulRequest;
-                            }
-                        }};
-
-                //
-                std::jthread totalRequestPrinter {
-                    [&]
-                    {
-                        auto startTime {std::chrono::high_resolution_clock::now()};
-
-                        while (true)
-                        {
-                            std::this_thread::sleep_for(std::chrono::seconds {5});
-
-                            auto elapsedTime {std::chrono::high_resolution_clock::now() - startTime};
-                            fmt::print("[-] Successful Request: {} | Failed Request: {} | TPS : {:.2f} req/s\r\n",
-                                       totalSuccessfulRequest.load(), totalFailedRequest.load(),
-                                       static_cast<double>(totalSuccessfulRequest.load() + totalFailedRequest.load()) /
-                                           std::chrono::duration_cast<std::chrono::seconds>(elapsedTime).count());
-                        }
-                    }};
-
-                fmt::print(fmt::fg(fmt::color::green), "[v] All users is active and testing the server!\r\n");
-
-                for (auto& thread: userThreads)
-                    thread.join();
+                applyLogOptions(loadConfig.client.traceHandshake);
+                ClientLog::getInstance().configure(logConfig);
+
+                // OpenSSL writes the kTLS sockets without `MSG_NOSIGNAL`, a server closing early must not kill us
+                if (loadConfig.client.ktls)
+                    std::signal(SIGPIPE, SIG_IGN);
+
+                // Move the KEM key generation of the client off the request path
+                if (keysharePool > 0)
+                    KeysharePool::getInstance().start(keysharePool, keysharePoolThreads);
+
+                loadConfig.duration = std::chrono::seconds {loadDuration};
+                LoadGenerator generator {loadConfig};
+                if (!generator.run())
+                    return std::exit(EXIT_FAILURE);
+                generator.report();
+                reportDroppedRecords(loadConfig.client.traceHandshake);
+
+                if (keysharePool == 0)
+                    return;
+                KeysharePool::getInstance().stop();
+                for (auto const& [algorithm, hits, misses]: KeysharePool::getInstance().getStatistics())
+                    fmt::print("[-] Keyshare pool {}: hits {} | misses {} | hit rate {:.1f}%\r\n", algorithm, hits,
+                               misses, hits + misses > 0 ? 100.0 * hits / (hits + misses) : 0.0);
+            });
+    }
+
+    // Handle `main bench-crypto` execution
+    auto mainBenchCrypto {main.add_subcommand(
+        "bench-crypto", "Measure the KEM and signature primitives through OpenSSL on an increasing number of threads")};
+    CryptoBenchConfig cryptoBenchConfig {.maxThreads = std::max(std::thread::hardware_concurrency(), 1u)};
+    uint32_t cryptoBenchDuration {static_cast<uint32_t>(cryptoBenchConfig.duration.count())};
+    {
+        mainBenchCrypto
+            ->add_option("--max-threads", cryptoBenchConfig.maxThreads,
+                         "The highest number of threads running a primitive concurrently, measured along with a "
+                         "single thread and every power of two below it (default: number of CPU cores)")
+            ->capture_default_str()
+            ->check(CLI::PositiveNumber);
+        mainBenchCrypto
+            ->add_option("--duration-ms", cryptoBenchDuration,
+                         "How long every primitive runs at every number of threads (in milliseconds)")
+            ->capture_default_str()
+            ->check(CLI::PositiveNumber);
+        mainBenchCrypto->add_option("--groups", cryptoBenchConfig.groups,
+                                    "The colon-separated KEM groups to measure (default: every supported group)");
+        mainBenchCrypto->add_option(
+            "--sigalgs", cryptoBenchConfig.sigalgs,
+            "The colon-separated signature algorithms to measure (default: every supported algorithm)");
+        mainBenchCrypto->add_option("--json-output-file", cryptoBenchConfig.jsonOutputPath,
+                                    "The path to the JSON result file (default: in the current working directory)");
+        mainBenchCrypto->callback(
+            [&]
+            {
+                cryptoBenchConfig.duration = std::chrono::milliseconds {cryptoBenchDuration};
+                CryptoBench bench {cryptoBenchConfig};
+                if (!bench.run())
+                    return std::exit(EXIT_FAILURE);
+            });
+    }
+
+    // Handle `main bench-handshake` execution
+    auto mainBenchHandshake {main.add_subcommand(
+        "bench-handshake", "Measure the CPU cost of in-memory TLS handshakes per KEM group and signature algorithm")};
+    HandshakeBenchConfig handshakeBenchConfig {.threads = std::max(std::thread::hardware_concurrency(), 1u)};
+    uint32_t handshakeBenchDuration {static_cast<uint32_t>(handshakeBenchConfig.duration.count())};
+    {
+        mainBenchHandshake
+            ->add_option("--threads", handshakeBenchConfig.threads,
+                         "The number of threads running handshakes, each pinned to its own core (default: number of "
+                         "CPU cores)")
+            ->capture_default_str()
+            ->check(CLI::PositiveNumber);
+        mainBenchHandshake
+            ->add_option("--duration-ms", handshakeBenchDuration,
+                         "How long the handshakes of every group and signature algorithm pair run (in milliseconds)")
+            ->capture_default_str()
+            ->check(CLI::PositiveNumber);
+        mainBenchHandshake->add_option(
+            "--groups", handshakeBenchConfig.groups,
+            "The colon-separated KEM groups offered by the client (default: every supported group)");
+        mainBenchHandshake->add_option(
+            "--sigalgs", handshakeBenchConfig.sigalgs,
+            "The colon-separated signature algorithms of the server certificate (default: every supported algorithm)");
+        mainBenchHandshake->add_option("--cert-compression", handshakeBenchConfig.certCompression,
+                                       "The colon-separated certificate compression algorithms of both sides, among "
+                                       "zlib, brotli and zstd (default: none)");
+        mainBenchHandshake->add_option("--json-output-file", handshakeBenchConfig.jsonOutputPath,
+                                       "The path to the JSON result file (default: in the current working directory)");
+        mainBenchHandshake->callback(
+            [&]
+            {
+                handshakeBenchConfig.duration = std::chrono::milliseconds {handshakeBenchDuration};
+                HandshakeBench bench {handshakeBenchConfig};
+                if (!bench.run())
+                    return std::exit(EXIT_FAILURE);
+            });
+    }
+
+    // Handle `main bench-descriptor` execution
+    auto mainBenchDescriptor {main.add_subcommand(
+        "bench-descriptor", "Measure the time the liboqs descriptor cache saves on every request of the oqs-provider")};
+    DescriptorBenchConfig descriptorBenchConfig {};
+    uint32_t descriptorBenchDuration {static_cast<uint32_t>(descriptorBenchConfig.duration.count())};
+    {
+        mainBenchDescriptor
+            ->add_option("--duration-ms", descriptorBenchDuration,
+                         "How long the requests of every algorithm run, with and without the cache (in milliseconds)")
+            ->capture_default_str()
+            ->check(CLI::PositiveNumber);
+        mainBenchDescriptor->add_option(
+            "--json-output-file", descriptorBenchConfig.jsonOutputPath,
+            "The path to the JSON result file (default: in the current working directory)");
+        mainBenchDescriptor->callback(
+            [&]
+            {
+                descriptorBenchConfig.duration = std::chrono::milliseconds {descriptorBenchDuration};
+                DescriptorBench bench {descriptorBenchConfig};
+                if (!bench.run())
+                    return std::exit(EXIT_FAILURE);
+            });
+    }
+
+    // Handle `main sweep` execution
+    auto mainSweep {main.add_subcommand(
+        "sweep", "Run the client against a live server for every KEM group and signature algorithm pair")};
+    SweepConfig sweepConfig {.load = {.clientThreads = std::max(std::thread::hardware_concurrency(), 1u)}};
+    uint32_t sweepDuration {10};
+    {
+        mainSweep->add_option("--server-host", sweepConfig.load.client.serverHost, "The server host address")
+            ->required()
+            ->check(CLI::TypeValidator<std::string> {});
+        mainSweep
+            ->add_option("--server-port", sweepConfig.load.client.serverPort,
+                         "The server host port, the server must run with --enable-control")
+            ->required()
+            ->check(CLI::PositiveNumber);
+        mainSweep->add_option("--concurrent-user", sweepConfig.load.concurrentUsers, "The number of concurrent user")
+            ->required()
+            ->check(CLI::PositiveNumber);
+        mainSweep
+            ->add_option("--client-threads", sweepConfig.load.clientThreads,
+                         "The number of threads running the concurrent users (default: number of CPU cores)")
+            ->capture_default_str()
+            ->check(CLI::PositiveNumber);
+        mainSweep
+            ->add_option("--data-length", sweepConfig.load.client.dummyDataLength,
+                         "The size of the data to be transmitted to the server (in bytes)")
+            ->required()
+            ->check(CLI::PositiveNumber);
+        mainSweep
+            ->add_option("--resumption-ratio", sweepConfig.load.client.resumptionRatio,
+                         "The fraction of requests resuming the previous TLS session of the user (0.0 to 1.0)")
+            ->capture_default_str()
+            ->check(CLI::Range(0.0, 1.0));
+        mainSweep
+            ->add_option("--duration-s", sweepDuration,
+                         "How long every group and signature algorithm pair runs (in seconds, 0 relies on --requests)")
+            ->capture_default_str()
+            ->check(CLI::NonNegativeNumber);
+        mainSweep
+            ->add_option("--requests", sweepConfig.load.requestLimit,
+                         "Stop every pair after this many completed requests (default: 0, no limit)")
+            ->check(CLI::NonNegativeNumber);
+        mainSweep->add_option(
+            "--groups", sweepConfig.groups,
+            "The colon-separated KEM groups offered by the client, wildcards allowed (default: every supported group)");
+        mainSweep->add_option("--sigalgs", sweepConfig.sigalgs,
+                              "The colon-separated signature algorithms of the server certificate, wildcards allowed "
+                              "(default: every supported algorithm)");
+        mainSweep->add_option("--credentials-dir", sweepConfig.credentialsDirectory,
+                              "The directory holding the <sigalg>.crt and <sigalg>.key credentials, the missing ones "
+                              "are generated there (default: generated in memory)");
+        mainSweep->add_option("--cert-compression", sweepConfig.load.client.certCompression,
+                              "The colon-separated certificate compression algorithms accepted, in order of "
+                              "preference, among zlib, brotli and zstd (default: none)");
+        mainSweep->add_option("--json-output-file", sweepConfig.jsonOutputPath,
+                              "The path to the JSON result file (default: in the current working directory)");
+        addLogOptions(mainSweep);
+        mainSweep->callback(
+            [&]
+            {
+                applyLogOptions(false);
+                ClientLog::getInstance().configure(logConfig);
+
+                if (sweepDuration == 0 and sweepConfig.load.requestLimit == 0)
+                {
+                    spdlog::error("Either --duration-s or --requests must bound every pair");
+                    return std::exit(EXIT_FAILURE);
+                }
+                sweepConfig.load.duration = std::chrono::seconds {sweepDuration};
+                Sweep sweep {sweepConfig};
+                if (!sweep.run())
+                    return std::exit(EXIT_FAILURE);
+                reportDroppedRecords(false);
             });
     }
 
@@ -0,0 +1,135 @@
+#include <array>
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+#include <utility>
+
+#include <lily/net/CertCompression.h>
+
+using namespace lily::core;
+
+namespace lily::net
+{
+    // The algorithms supported by the linked OpenSSL, by name
+    static constexpr auto SUPPORTED_ALGORITHMS {std::to_array<std::pair<std::string_view, int>>({
+#if defined(LILY_CERT_COMPRESSION) and !defined(OPENSSL_NO_ZLIB)
+        {"zlib", TLSEXT_comp_cert_zlib},
+#endif
+#if defined(LILY_CERT_COMPRESSION) and !defined(OPENSSL_NO_BROTLI)
+        {"brotli", TLSEXT_comp_cert_brotli},
+#endif
+#if defined(LILY_CERT_COMPRESSION) and !defined(OPENSSL_NO_ZSTD)
+        {"zstd", TLSEXT_comp_cert_zstd},
+#endif
+        {"", 0},
+    })};
+
+    static std::string_view getAlgorithmName(int algorithm)
+    {
+        for (auto const& [name, id]: SUPPORTED_ALGORITHMS)
+            if (id == algorithm)
+                return name;
+        return "unknown";
+    }
+
+    Expect<std::vector<int>> parseCertCompression(std::string_view algorithms)
+    {
+        std::vector<int> parsed {};
+        while (!algorithms.empty())
+        {
+            auto end {algorithms.find(':')};
+            auto name {algorithms.substr(0, end)};
+            algorithms = end == std::string_view::npos ? std::string_view {} : algorithms.substr(end + 1);
+
+            auto id {0};
+            for (auto const& supported: SUPPORTED_ALGORITHMS)
+                if (!name.empty() and supported.first == name)
+                    id = supported.second;
+            if (id == 0)
+            {
+                spdlog::error("Certificate compression `{}` is not supported by the linked OpenSSL ({})", name,
+                              OPENSSL_VERSION_TEXT);
+                return ErrorCode::LILY_ERRORCODE_EXPECTED;
+            }
+            parsed.push_back(id);
+        }
+        return parsed;
+    }
+
+    Expect<void> configureCertCompression([[maybe_unused]] SSL_CTX* ctx,
+                                          [[maybe_unused]] std::vector<int> const& algorithms)
+    {
+#ifdef LILY_CERT_COMPRESSION
+        if (algorithms.empty())
+        {
+            SSL_CTX_set_options(ctx, SSL_OP_NO_TX_CERTIFICATE_COMPRESSION | SSL_OP_NO_RX_CERTIFICATE_COMPRESSION);
+            return success;
+        }
+
+        auto preference {algorithms};
+        if (SSL_CTX_set1_cert_comp_preference(ctx, preference.data(), preference.size()) <= 0)
+        {
+            spdlog::error("Set certificate compression preference failed! Cause: SSL_CTX_set1_cert_comp_preference");
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+        SSL_CTX_clear_options(ctx, SSL_OP_NO_TX_CERTIFICATE_COMPRESSION | SSL_OP_NO_RX_CERTIFICATE_COMPRESSION);
+#endif
+        // Without the API, no algorithm can be parsed and OpenSSL never compresses
+        return success;
+    }
+
+    Expect<std::vector<CompressedCertificate>> compressCertificate([[maybe_unused]] SSL_CTX* ctx,
+                                                                   [[maybe_unused]] std::vector<int> const& algorithms)
+    {
+        std::vector<CompressedCertificate> compressed {};
+#ifdef LILY_CERT_COMPRESSION
+        if (algorithms.empty())
+            return compressed;
+
+        if (SSL_CTX_compress_certs(ctx, 0) <= 0)
+        {
+            spdlog::error("Certificate compression failed! Cause: SSL_CTX_compress_certs");
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+
+        // Name the chain after its key, which tells the signature algorithm apart
+        auto keyName {EVP_PKEY_get0_type_name(SSL_CTX_get0_privatekey(ctx))};
+        for (auto algorithm: algorithms)
+        {
+            unsigned char* data {};
+            std::size_t originalLength {};
+            auto length {SSL_CTX_get1_compressed_cert(ctx, algorithm, &data, &originalLength)};
+            if (length == 0)
+            {
+                spdlog::error("Certificate compression with {} failed! Cause: SSL_CTX_get1_compressed_cert",
+                              getAlgorithmName(algorithm));
+                return ErrorCode::LILY_ERRORCODE_EXPECTED;
+            }
+            compressed.push_back({
+                .algorithm      = algorithm,
+                .data           = {data, data + length},
+                .originalLength = originalLength,
+            });
+            OPENSSL_free(data);
+
+            fmt::print("[-] Certificate chain `{}` compressed with {}: {} -> {} bytes ({:.1f}%)\r\n",
+                       keyName == nullptr ? "unknown" : keyName, getAlgorithmName(algorithm), originalLength, length,
+                       100.0 * length / originalLength);
+        }
+#endif
+        return compressed;
+    }
+
+    bool useCompressedCertificate([[maybe_unused]] SSL* ssl,
+                                  [[maybe_unused]] std::vector<CompressedCertificate> const& certificates)
+    {
+#ifdef LILY_CERT_COMPRESSION
+        // The connection copies the compressed chains, nothing is compressed again
+        for (auto const& certificate: certificates)
+            if (SSL_set1_compressed_cert(ssl, certificate.algorithm,
+                                         const_cast<unsigned char*>(certificate.data.data()), certificate.data.size(),
+                                         certificate.originalLength) <= 0)
+                return false;
+#endif
+        return true;
+    }
+} // namespace lily::net
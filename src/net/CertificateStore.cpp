@@ -0,0 +1,152 @@
+#include <fstream>
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/x509v3.h>
+#include <spdlog/spdlog.h>
+#include <sstream>
+#include <string>
+
+#include <lily/net/CertificateStore.h>
+
+using namespace lily::core;
+
+namespace lily::net
+{
+    CertificateStore::Credentials::~Credentials()
+    {
+        X509_free(this->certificate);
+        sk_X509_pop_free(this->chain, X509_free);
+        EVP_PKEY_free(this->privateKey);
+    }
+
+    // Returns whether OpenSSL can sign with the credentials using the signature algorithms offered by the client.
+    // `CERT_PKEY_VALID` is not used, as it also requires the ECDSA curve among the client groups, unlike TLS 1.3.
+    static bool isUsable(SSL* ssl, CertificateStore::Credentials const& credentials)
+    {
+        return (SSL_check_chain(ssl, credentials.certificate, credentials.privateKey, credentials.chain) &
+                CERT_PKEY_EE_SIGNATURE) != 0;
+    }
+
+    int CertificateStore::onCertificate(SSL* ssl, void* arg)
+    {
+        auto credentials {static_cast<CertificateStore*>(arg)->current.load()};
+        if (!credentials or credentials->empty())
+            return 1;
+
+        // A single certificate needs no selection. Otherwise, prefer the first usable credentials naming the server
+        // requested through SNI, then the first usable ones.
+        Credentials const* selected {credentials->size() == 1 ? credentials->front().get() : nullptr};
+        Credentials const* fallback {};
+        auto serverName {SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name)};
+        for (auto it {credentials->begin()}; selected == nullptr and it != credentials->end(); ++it)
+        {
+            if (!isUsable(ssl, **it))
+                continue;
+            if (serverName == nullptr or X509_check_host((*it)->certificate, serverName, 0, 0, nullptr) == 1)
+                selected = it->get();
+            else if (fallback == nullptr)
+                fallback = it->get();
+        }
+        if (selected == nullptr)
+            selected = fallback;
+
+        // Keep the certificate of the context when none is usable, the handshake then fails as without the store
+        if (selected == nullptr)
+            return 1;
+
+        // The connection takes its own references and copies, so the credentials may be replaced right after
+        return SSL_use_cert_and_key(ssl, selected->certificate, selected->privateKey, selected->chain, 1) == 1 and
+               useCompressedCertificate(ssl, selected->compressed);
+    }
+
+    Expect<std::shared_ptr<CertificateStore::Credentials const>> CertificateStore::parse(std::string_view pem) const
+    {
+        // Split the private key from the certificates, as the PEM readers skip the blocks of another type
+        static constexpr std::string_view BEGIN {"-----BEGIN "};
+        std::string certificates {};
+        std::string privateKey {};
+        for (auto begin {pem.find(BEGIN)}; begin != std::string_view::npos;)
+        {
+            auto next {pem.find(BEGIN, begin + BEGIN.size())};
+            auto block {pem.substr(begin, next == std::string_view::npos ? pem.size() - begin : next - begin)};
+            (block.substr(0, block.find('\n')).find("PRIVATE KEY") != std::string_view::npos ? privateKey
+                                                                                               : certificates)
+                .append(block);
+            begin = next;
+        }
+
+        auto credentials {std::make_shared<Credentials>()};
+        std::unique_ptr<BIO, decltype(&BIO_free)> certificateBIO {
+            BIO_new_mem_buf(certificates.data(), static_cast<int>(certificates.size())), BIO_free};
+        std::unique_ptr<BIO, decltype(&BIO_free)> privateKeyBIO {
+            BIO_new_mem_buf(privateKey.data(), static_cast<int>(privateKey.size())), BIO_free};
+        credentials->chain = sk_X509_new_null();
+        if (!certificateBIO or !privateKeyBIO or credentials->chain == nullptr)
+        {
+            spdlog::error("Failed to create the credentials BIO");
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+
+        credentials->certificate = PEM_read_bio_X509(certificateBIO.get(), nullptr, nullptr, nullptr);
+        if (credentials->certificate == nullptr)
+        {
+            spdlog::error("Failed to read the certificate of the credentials");
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+        while (auto intermediate {PEM_read_bio_X509(certificateBIO.get(), nullptr, nullptr, nullptr)})
+            sk_X509_push(credentials->chain, intermediate);
+
+        // Reading stops at the end of the certificates, which is not an error
+        ERR_clear_error();
+
+        credentials->privateKey = PEM_read_bio_PrivateKey(privateKeyBIO.get(), nullptr, nullptr, nullptr);
+        if (credentials->privateKey == nullptr)
+        {
+            spdlog::error("Failed to read the private key of the credentials");
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+        if (X509_check_private_key(credentials->certificate, credentials->privateKey) != 1)
+        {
+            spdlog::error("The private key of the credentials does not match the certificate");
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+
+        // Compress the chain once in a context of its own, as OpenSSL only compresses the chain of a context
+        if (!this->compression.empty())
+        {
+            std::unique_ptr<SSL_CTX, decltype(&SSL_CTX_free)> ctx {SSL_CTX_new(TLS_server_method()), SSL_CTX_free};
+            if (!ctx or SSL_CTX_use_cert_and_key(ctx.get(), credentials->certificate, credentials->privateKey,
+                                                 credentials->chain, 1) != 1)
+            {
+                spdlog::error("Failed to create the context compressing the credentials");
+                return ErrorCode::LILY_ERRORCODE_EXPECTED;
+            }
+            BOOST_OUTCOME_TRY(configureCertCompression(ctx.get(), this->compression));
+            BOOST_OUTCOME_TRY(decltype(auto) compressed, compressCertificate(ctx.get(), this->compression));
+            credentials->compressed = std::move(compressed);
+        }
+        return credentials;
+    }
+
+    Expect<std::shared_ptr<CertificateStore::Credentials const>> CertificateStore::load(
+        std::filesystem::path const& certificatePath, std::filesystem::path const& privateKeyPath) const
+    {
+        std::stringstream pem {};
+        for (auto const& path: {certificatePath, privateKeyPath})
+        {
+            std::ifstream stream {path};
+            if (!stream.is_open())
+            {
+                spdlog::error("Failed to open the credentials file {}", path.string());
+                return ErrorCode::LILY_ERRORCODE_EXPECTED;
+            }
+            pem << stream.rdbuf() << '\n';
+        }
+        return this->parse(pem.str());
+    }
+
+    void CertificateStore::install(SSL_CTX* ctx)
+    {
+        SSL_CTX_set_cert_cb(ctx, &CertificateStore::onCertificate, this);
+    }
+} // namespace lily::net
@@ -1,40 +1,71 @@
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <spdlog/spdlog.h>
+#include <sstream>
+#include <string_view>
+#include <vector>
 
 #include <lily/core/Constants.h>
 #include <lily/log/ClientLog.h>
+#include <lily/net/CertCompression.h>
 #include <lily/net/ClientConnection.h>
+#include <lily/net/HandshakeTrace.h>
 
 using namespace lily::core;
 using namespace lily::log;
 
 namespace lily::net
 {
-    ClientConnection::ClientConnection():
-        ioc(std::make_unique<boost::beast::net::io_context>()), ctx {boost::asio::ssl::context::tlsv13_client}
+    // Identifies the connections in the client log and the trace log
+    static std::atomic_uint64_t NEXT_CONNECTION_ID {};
+
+    // Spreads the connections of every user across the source addresses
+    static std::atomic_uint64_t NEXT_SOURCE_ADDRESS {};
+
+    // Whether an error tells the server closed the connection abruptly, rather than a failed step
+    static bool isConnectionReset(boost::beast::error_code const& ec)
+    {
+        return ec == boost::asio::error::connection_reset or ec == boost::asio::error::broken_pipe or
+               ec == boost::beast::net::ssl::error::stream_truncated;
+    }
+
+    ClientConnection::ClientConnection(ClientConfig const& config):
+        config {config}, ctx {boost::asio::ssl::context::tlsv13_client}
     {
     }
 
-    ClientConnection::ClientConnection(ClientConnection&& other): ioc(std::move(other.ioc)), ctx(std::move(other.ctx))
+    ClientConnection::ClientConnection(ClientConnection&& other):
+        config(std::move(other.config)), ctx(std::move(other.ctx)), resolvedServer(std::move(other.resolvedServer)),
+        sourceAddresses(std::move(other.sourceAddresses)), sendServerName(other.sendServerName),
+        serializedRequest(std::move(other.serializedRequest)), requestHeaderSize(other.requestHeaderSize),
+        contextSetupDuration(other.contextSetupDuration), resolveDuration(other.resolveDuration)
     {
     }
 
     ClientConnection& ClientConnection::operator=(ClientConnection&& other)
     {
-        this->ioc = std::move(other.ioc);
-        this->ctx = std::move(other.ctx);
+        this->config               = std::move(other.config);
+        this->ctx                  = std::move(other.ctx);
+        this->resolvedServer       = std::move(other.resolvedServer);
+        this->sourceAddresses      = std::move(other.sourceAddresses);
+        this->sendServerName       = other.sendServerName;
+        this->serializedRequest    = std::move(other.serializedRequest);
+        this->requestHeaderSize    = other.requestHeaderSize;
+        this->contextSetupDuration = other.contextSetupDuration;
+        this->resolveDuration      = other.resolveDuration;
         return *this;
     }
 
-    Expect<void> ClientConnection::sendDummyData(std::string const& serverHost, uint16_t serverPort,
-                                                 std::string const& tlsGroup, uint32_t dummyDataLength)
+    Expect<void> ClientConnection::configureContext(boost::asio::ssl::context& ctx, ClientConfig const& config)
     {
-        ClientConnection connection {};
-
         // Variable that collect the error code thrown by boost function
         boost::beast::error_code ec {};
 
         // Disable the verification. The verification will only be necessary for mutual TLS.
-        std::ignore = connection.ctx.set_verify_mode(boost::asio::ssl::verify_none, ec);
+        std::ignore = ctx.set_verify_mode(boost::asio::ssl::verify_none, ec);
         if (ec)
         {
             spdlog::error("Lily-PQC client context set_verify_mode failed! Why: {}", ec.message());
@@ -42,117 +73,502 @@ namespace lily::net
         }
 
         // Force the client to use TLS1.3
-        SSL_CTX_set_min_proto_version(connection.ctx.native_handle(), TLS1_3_VERSION);
-        SSL_CTX_set_max_proto_version(connection.ctx.native_handle(), TLS1_3_VERSION);
+        SSL_CTX_set_min_proto_version(ctx.native_handle(), TLS1_3_VERSION);
+        SSL_CTX_set_max_proto_version(ctx.native_handle(), TLS1_3_VERSION);
 
         // Set the key exchange algorithm
-        if (SSL_CTX_set1_groups_list(connection.ctx.native_handle(), tlsGroup.c_str()) <= 0)
+        if (SSL_CTX_set1_groups_list(ctx.native_handle(), config.tlsGroup.c_str()) <= 0)
         {
             spdlog::error("Lily-PQC client context set key exchange algorithm failed! Cause: SSL_CTX_set1_groups_list");
             return ErrorCode::LILY_ERRORCODE_EXPECTED;
         }
 
         // Set the supported signature algorithm
-        if (SSL_CTX_set1_sigalgs_list(connection.ctx.native_handle(), constants::SUPPORTED_SIGALGS_LIST) <= 0)
+        if (SSL_CTX_set1_sigalgs_list(ctx.native_handle(), constants::SUPPORTED_SIGALGS_LIST) <= 0)
         {
             spdlog::error(
                 "Lily-PQC client context set supported signature algorithm failed! Cause: SSL_CTX_set1_sigalgs_list");
             return ErrorCode::LILY_ERRORCODE_EXPECTED;
         }
 
-        // These objects perform our I/O
-        boost::asio::ip::tcp::resolver resolver {*connection.ioc.get()};
-        boost::asio::ssl::stream<boost::beast::tcp_stream> stream {*connection.ioc.get(), connection.ctx};
+        // Offer only the configured TLS 1.3 cipher suites, the server then has to pick one of them
+        if (!config.cipherSuites.empty() and
+            SSL_CTX_set_ciphersuites(ctx.native_handle(), config.cipherSuites.c_str()) <= 0)
+        {
+            spdlog::error("Lily-PQC client context set cipher suites failed! Cause: SSL_CTX_set_ciphersuites");
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+
+        // Limit the plaintext carried by every record sent
+        if (config.maxRecordSize > 0 and SSL_CTX_set_max_send_fragment(ctx.native_handle(), config.maxRecordSize) <= 0)
+        {
+            spdlog::error("Lily-PQC client context set max record size failed! It must be between 512 and 16384");
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+
+        // Hand the records over to the kernel once the handshake completes
+        if (config.ktls)
+        {
+            BOOST_OUTCOME_TRY(TlsStream::enableKtls(ctx.native_handle()));
+        }
+
+        // Accept the certificate chains compressed with the configured algorithms
+        BOOST_OUTCOME_TRY(decltype(auto) compression, parseCertCompression(config.certCompression));
+        BOOST_OUTCOME_TRY(configureCertCompression(ctx.native_handle(), compression));
+
+        // Account the handshake bytes of every connection, and time the handshake messages of the traced ones
+        HandshakeTrace::install(ctx.native_handle());
+        return success;
+    }
+
+    Expect<ClientConnection> ClientConnection::create(ClientConfig const& config)
+    {
+        auto beginSetupTime {std::chrono::high_resolution_clock::now()};
+        ClientConnection connection {config};
+
+        // Configure the TLS 1.3 settings shared by every request
+        BOOST_OUTCOME_TRY(configureContext(connection.ctx, config));
 
-        // Look up the domain name
-        auto resolvedServer {resolver.resolve(serverHost, fmt::format("{}", serverPort), ec)};
+        auto beginResolveTime {std::chrono::high_resolution_clock::now()};
+        connection.contextSetupDuration =
+            std::chrono::duration_cast<std::chrono::microseconds>(beginResolveTime - beginSetupTime);
+
+        // Look up the domain name once, the results are reused by every request
+        boost::beast::error_code ec {};
+        boost::asio::io_context ioc {};
+        boost::asio::ip::tcp::resolver resolver {ioc};
+        connection.resolvedServer = resolver.resolve(config.serverHost, fmt::format("{}", config.serverPort), ec);
         if (ec)
         {
             spdlog::error("Lily-PQC client failed to resolve server! Why: {}", ec.message());
             return ErrorCode::LILY_ERRORCODE_EXPECTED;
         }
+        connection.resolveDuration = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::high_resolution_clock::now() - beginResolveTime);
+
+        // SNI only carries host names, a server addressed by IP is not named
+        std::ignore               = boost::asio::ip::make_address(config.serverHost, ec);
+        connection.sendServerName = static_cast<bool>(ec);
+
+        // Parse the source addresses the connections are bound to
+        for (auto const& sourceAddress: config.sourceAddresses)
+        {
+            connection.sourceAddresses.push_back(boost::asio::ip::make_address(sourceAddress, ec));
+            if (ec)
+            {
+                spdlog::error("Lily-PQC client source address `{}` is invalid! Why: {}", sourceAddress, ec.message());
+                return ErrorCode::LILY_ERRORCODE_EXPECTED;
+            }
+        }
+
+        // A connection is only bound to a source address of the family of the server address
+        auto matchesFamily {[&connection](auto const& entry)
+                            {
+                                auto isV6 {entry.endpoint().address().is_v6()};
+                                return std::ranges::any_of(connection.sourceAddresses, [isV6](auto const& address)
+                                                           { return address.is_v6() == isV6; });
+                            }};
+        if (!connection.sourceAddresses.empty() and std::ranges::none_of(connection.resolvedServer, matchesFamily))
+        {
+            spdlog::error("Lily-PQC client source addresses do not match the address family of the server");
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
 
-        // Make the connection on the IP address we get from a lookup
-        std::ignore = boost::beast::get_lowest_layer(stream).connect(resolvedServer, ec);
+        // Serialize the request once, with the header announcing the whole dummy body
+        boost::beast::http::request<boost::beast::http::empty_body> req {boost::beast::http::verb::post, "/", 11};
+        req.set(boost::beast::http::field::host, config.serverHost);
+        req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+        req.set(boost::beast::http::field::content_type, "text/plain");
+        req.keep_alive(config.keepAlive);
+        req.content_length(config.dummyDataLength);
+        std::ostringstream header {};
+        header << req.base();
+        connection.serializedRequest = header.str();
+        connection.requestHeaderSize = connection.serializedRequest.size();
+        connection.serializedRequest.append(std::min<uint64_t>(config.dummyDataLength, constants::BODY_CHUNK_SIZE),
+                                            'A');
+
+        return connection;
+    }
+
+    Expect<void> ClientConnection::openSocket(boost::asio::ip::tcp::socket& socket,
+                                              boost::asio::ip::tcp::endpoint const& endpoint) const
+    {
+        // Variable that collect the error code thrown by boost function
+        boost::beast::error_code ec {};
+
+        // Open the socket communication, closing the one of the previous endpoint, if any
+        std::ignore = socket.close(ec);
+        std::ignore = socket.open(endpoint.protocol(), ec);
         if (ec)
         {
-            if (ec != boost::asio::error::connection_refused and ec != boost::beast::net::ssl::error::stream_truncated)
+            spdlog::error("Lily-PQC client connection open failed! Why: {}", ec.message());
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+        BOOST_OUTCOME_TRY(applySocketOptions(socket, this->config.socketOptions));
+
+        // Send the ClientHello with the SYN, once the server granted a cookie to a previous connection
+        if (this->config.socketOptions.fastOpen)
+        {
+            using fast_open_connect = boost::asio::detail::socket_option::boolean<IPPROTO_TCP, TCP_FASTOPEN_CONNECT>;
+            std::ignore             = socket.set_option(fast_open_connect(true), ec);
+            if (ec)
+            {
+                spdlog::error("Lily-PQC client connection set_option TCP_FASTOPEN_CONNECT failed! Why: {}",
+                              ec.message());
+                return ErrorCode::LILY_ERRORCODE_EXPECTED;
+            }
+        }
+
+        if (this->sourceAddresses.empty())
+            return success;
+
+        // Bind to the next source address of the family, the port is only picked on connect. As the port then only
+        // has to be unique for the whole address pair, every source address gets its own range of ephemeral ports.
+        auto next {NEXT_SOURCE_ADDRESS.fetch_add(1, std::memory_order_relaxed)};
+        for (std::size_t i {}; i < this->sourceAddresses.size(); ++i)
+        {
+            auto const& sourceAddress {this->sourceAddresses[(next + i) % this->sourceAddresses.size()]};
+            if (sourceAddress.is_v6() != endpoint.address().is_v6())
+                continue;
+
+            using no_port = boost::asio::detail::socket_option::boolean<IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT>;
+            std::ignore   = socket.set_option(no_port(true), ec);
+            if (!ec)
+                std::ignore = socket.bind({sourceAddress, 0}, ec);
+            if (ec)
             {
-                spdlog::error("Lily-PQC client connection to server failed! Why: {}", ec.message());
+                spdlog::error("Lily-PQC client connection bind to {} failed! Why: {}", sourceAddress.to_string(),
+                              ec.message());
                 return ErrorCode::LILY_ERRORCODE_EXPECTED;
             }
-            return ErrorCode::LILY_ERRORCODE_UNEXPECTED;
+            return success;
+        }
+        return ErrorCode::LILY_ERRORCODE_UNEXPECTED;
+    }
+
+    boost::asio::awaitable<Expect<int64_t>> ClientConnection::handshake(KeptConnection& connection,
+                                                                        ClientSessionStore& sessionStore,
+                                                                        FailureCause& failure)
+    {
+        // Variable that collect the error code thrown by boost function
+        boost::beast::error_code ec {boost::asio::error::not_found};
+
+        // This object performs our I/O on the executor of the calling coroutine
+        auto stream {
+            std::make_unique<TlsStream>(co_await boost::asio::this_coro::executor, this->ctx, this->config.ktls)};
+
+        // Make the connection on the IP addresses we got from the lookup, in turn until one accepts it. An address
+        // without any source address of its family is skipped.
+        auto& socket {boost::beast::get_lowest_layer(*stream).socket()};
+        for (auto const& entry: this->resolvedServer)
+        {
+            if (auto opened {this->openSocket(socket, entry.endpoint())}; !opened)
+            {
+                if (opened.error() == ErrorCode::LILY_ERRORCODE_UNEXPECTED)
+                    continue;
+                failure = FailureCause::CONNECT;
+                co_return opened.error();
+            }
+            co_await socket.async_connect(entry.endpoint(),
+                                          boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+            if (!ec)
+                break;
         }
+        if (ec)
+        {
+            if (ec == boost::asio::error::connection_refused)
+            {
+                failure = FailureCause::CONNECTION_REFUSED;
+                co_return ErrorCode::LILY_ERRORCODE_UNEXPECTED;
+            }
 
-        // Perform the SSL handshake
+            // Every ephemeral port of the address pair is taken, mostly by connections in TIME_WAIT
+            failure = ec == boost::system::errc::address_not_available or ec == boost::asio::error::address_in_use
+                          ? FailureCause::NO_LOCAL_PORT
+                          : FailureCause::CONNECT;
+            spdlog::error("Lily-PQC client connection to server failed! Why: {}", ec.message());
+            co_return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+
+        // Name the server, so it can select the matching certificate, and offer the previous session ticket of this
+        // user, if any
+        if (this->sendServerName)
+            SSL_set_tlsext_host_name(stream->native_handle(), this->config.serverHost.c_str());
+        sessionStore.offer(stream->native_handle());
+
+        // Perform the SSL handshake. The trace lives as long as the connection, as it sees every record.
+        connection.connectionId = NEXT_CONNECTION_ID.fetch_add(1, std::memory_order_relaxed);
+        connection.trace.attach(stream->native_handle());
         auto beginHandshakeTime {std::chrono::high_resolution_clock::now()};
-        std::ignore = stream.handshake(boost::asio::ssl::stream_base::client, ec);
+        co_await stream->async_handshake(boost::asio::ssl::stream_base::client,
+                                         boost::asio::redirect_error(boost::asio::use_awaitable, ec));
         auto handshakeDuration {std::chrono::duration_cast<std::chrono::microseconds>(
                                     std::chrono::high_resolution_clock::now() - beginHandshakeTime)
                                     .count()};
         if (ec)
         {
-            if (ec != boost::beast::net::ssl::error::stream_truncated and ec != boost::asio::error::broken_pipe and
-                ec != boost::asio::error::connection_reset)
+            if (!isConnectionReset(ec))
             {
+                failure = FailureCause::HANDSHAKE;
                 spdlog::error("Lily-PQC client SSL handshake with server failed! Why: {}", ec.message());
-                return ErrorCode::LILY_ERRORCODE_EXPECTED;
+                co_return ErrorCode::LILY_ERRORCODE_EXPECTED;
             }
-            return ErrorCode::LILY_ERRORCODE_UNEXPECTED;
+            failure = FailureCause::CONNECTION_RESET;
+            co_return ErrorCode::LILY_ERRORCODE_UNEXPECTED;
         }
 
-        // Set up an HTTP GET request message
-        boost::beast::http::request<boost::beast::http::string_body> req {boost::beast::http::verb::post, "/", 11};
-        req.set(boost::beast::http::field::host, serverHost);
-        req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-        req.set(boost::beast::http::field::content_type, "text/plain");
-        req.keep_alive(false);
+        connection.trace.finish(boost::beast::get_lowest_layer(*stream).socket().native_handle());
+        if (this->config.traceHandshake)
+            connection.trace.write(connection.connectionId);
 
-        // Create dummy body with the given size
-        req.body().assign(dummyDataLength, 'A');
-        req.prepare_payload();
+        connection.stream = std::move(stream);
+        co_return handshakeDuration;
+    }
+
+    boost::asio::awaitable<Expect<RequestResult>> ClientConnection::sendDummyData(
+        ClientSessionStore& sessionStore, std::optional<std::chrono::steady_clock::time_point> intendedStart,
+        KeptConnection* kept, FailureCause* failure)
+    {
+        auto requestStart {intendedStart.value_or(std::chrono::steady_clock::now())};
+        auto startDelay {std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                               requestStart)
+                             .count()};
+
+        // Variable that collect the error code thrown by boost function
+        boost::beast::error_code ec {};
+
+        // Reuse the connection kept open by the previous request of the user, if any. No handshake is measured then.
+        KeptConnection single {};
+        auto& connection {kept != nullptr ? *kept : single};
+        FailureCause ignoredFailure {};
+        auto& cause {failure != nullptr ? *failure : ignoredFailure};
+        int64_t handshakeDuration {-1};
+        auto fresh {!connection.stream};
+        if (fresh)
+        {
+            auto result {co_await this->handshake(connection, sessionStore, cause)};
+            if (!result)
+                co_return result.error();
+            handshakeDuration = result.value();
+        }
+
+        // The connection is only kept again once the request succeeds, a failed one is closed and replaced
+        auto owner {std::move(connection.stream)};
+        auto& stream {*owner};
+        auto& perf {connection.trace.getPerf()};
+        perf.reset(PerfSection::WRITE);
+        perf.reset(PerfSection::READ);
 
-        // Send the HTTP request to the remote host
+        // Send the shared request, holding the header and the first chunk of the dummy body
         auto beginWriteTime {std::chrono::high_resolution_clock::now()};
-        auto writeSize {boost::beast::http::write(stream, req, ec)};
-        auto writeDuration {std::chrono::duration_cast<std::chrono::microseconds>(
-                                std::chrono::high_resolution_clock::now() - beginWriteTime)
-                                .count()};
+        auto writeSize {co_await boost::asio::async_write(stream, boost::asio::buffer(this->serializedRequest),
+                                                          boost::asio::redirect_error(boost::asio::use_awaitable, ec))};
+        perf.update(PerfSection::WRITE);
         if (ec)
         {
+            cause = isConnectionReset(ec) ? FailureCause::CONNECTION_RESET : FailureCause::WRITE;
             spdlog::error("Lily-PQC client SSL write to server failed! Why: {}", ec.message());
-            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+            co_return ErrorCode::LILY_ERRORCODE_EXPECTED;
         }
 
+        // The server echoes the body as it arrives, so the rest of a larger body is written while the echo is read.
+        // Otherwise both sides would wait for each other once the socket buffers are full.
+        auto executor {co_await boost::asio::this_coro::executor};
+        auto chunkSize {this->serializedRequest.size() - this->requestHeaderSize};
+        std::optional<std::chrono::high_resolution_clock::time_point> endWriteTime {};
+        boost::beast::error_code writeEc {};
+        boost::asio::steady_timer bodyWritten {executor, std::chrono::steady_clock::time_point::max()};
+        if (this->config.dummyDataLength == chunkSize)
+            endWriteTime = std::chrono::high_resolution_clock::now();
+        else
+            boost::asio::co_spawn(executor,
+                                  this->writeBody(stream, this->config.dummyDataLength - chunkSize, writeSize, writeEc),
+                                  [&endWriteTime, &bodyWritten, &perf](std::exception_ptr)
+                                  {
+                                      perf.update(PerfSection::WRITE);
+                                      endWriteTime = std::chrono::high_resolution_clock::now();
+                                      bodyWritten.cancel();
+                                  });
+
         // This buffer is used for reading and must be persisted
         boost::beast::flat_buffer buffer {};
 
-        // Declare a container to hold the response
-        boost::beast::http::response<boost::beast::http::dynamic_body> res {};
+        // Read the echoed body into a single chunk that is overwritten, whatever its size
+        boost::beast::http::response_parser<boost::beast::http::buffer_body> parser {};
+        parser.body_limit(std::numeric_limits<std::uint64_t>::max());
+        std::vector<char> body(std::max<std::size_t>(chunkSize, 1));
 
         // Receive the HTTP response
         auto beginReadTime {std::chrono::high_resolution_clock::now()};
-        auto readSize {boost::beast::http::read(stream, buffer, res, ec)};
+        auto readSize {co_await boost::beast::http::async_read_header(
+            stream, buffer, parser, boost::asio::redirect_error(boost::asio::use_awaitable, ec))};
+        while (!ec and !parser.is_done())
+        {
+            parser.get().body().data = body.data();
+            parser.get().body().size = body.size();
+            readSize += co_await boost::beast::http::async_read(
+                stream, buffer, parser, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+            if (ec == boost::beast::http::error::need_buffer)
+                ec = {};
+        }
         auto readDuration {std::chrono::duration_cast<std::chrono::microseconds>(
                                std::chrono::high_resolution_clock::now() - beginReadTime)
                                .count()};
+        perf.update(PerfSection::READ);
+
+        // Wait for the rest of the body to be written, aborting it when the echo failed
+        if (!endWriteTime)
+        {
+            if (ec)
+                boost::beast::get_lowest_layer(stream).cancel();
+            boost::beast::error_code ignored {};
+            co_await bodyWritten.async_wait(boost::asio::redirect_error(boost::asio::use_awaitable, ignored));
+        }
+        auto writeDuration {
+            std::chrono::duration_cast<std::chrono::microseconds>(*endWriteTime - beginWriteTime).count()};
+        if (writeEc)
+        {
+            cause = isConnectionReset(writeEc) ? FailureCause::CONNECTION_RESET : FailureCause::WRITE;
+            spdlog::error("Lily-PQC client SSL write to server failed! Why: {}", writeEc.message());
+            co_return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
         if (ec)
         {
+            cause = isConnectionReset(ec) ? FailureCause::CONNECTION_RESET : FailureCause::READ;
             spdlog::error("Lily-PQC client SSL read from server failed! Why: {}", ec.message());
-            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+            co_return ErrorCode::LILY_ERRORCODE_EXPECTED;
         }
 
-        // Log server SSL performance
-        ClientLog::getInstance().write(handshakeDuration, writeSize, writeDuration, readSize, readDuration);
+        auto latency {std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                            requestStart)
+                          .count()};
+
+        // Keep the session ticket received from the server with the first response of a connection
+        if (fresh)
+            sessionStore.update(stream.native_handle());
+
+        // Log server SSL performance, a request over a kept connection has no handshake
+        auto accounting {fresh ? connection.trace.getAccounting() : HandshakeTrace::Accounting {}};
+        ClientLog::getInstance().write({.connId          = connection.connectionId,
+                                        .hsDurationUs    = handshakeDuration,
+                                        .writeSize       = writeSize,
+                                        .writeDurationUs = writeDuration,
+                                        .recvSize        = readSize,
+                                        .recvDurationUs  = readDuration,
+                                        .resumed         = fresh and sessionStore.wasResumed(),
+                                        .startDelayUs    = startDelay,
+                                        .latencyUs       = latency,
+                                        .hsBytesSent     = accounting.bytesSent,
+                                        .hsBytesRecv     = accounting.bytesReceived,
+                                        .hsRecordsSent   = accounting.recordsSent,
+                                        .hsRecordsRecv   = accounting.recordsReceived,
+                                        .hsFlights       = accounting.flights,
+                                        .rttUs           = accounting.rttUs,
+                                        .retransmits     = accounting.retransmits,
+                                        .hsMemBytes      = accounting.memBytes,
+                                        .hsMemPeak       = accounting.memPeak,
+                                        .hsMemAllocs     = accounting.memAllocations,
+                                        .hsPerf          = fresh ? perf.getCounts(PerfSection::HANDSHAKE)
+                                                                 : PerfCounts {},
+                                        .writePerf       = perf.getCounts(PerfSection::WRITE),
+                                        .recvPerf        = perf.getCounts(PerfSection::READ),
+                                        .ktlsSend        = stream.isKernelSend(),
+                                        .ktlsRecv        = stream.isKernelReceive()});
+
+        RequestResult result {
+            .handshake     = fresh ? std::optional {accounting} : std::nullopt,
+            .bytesSent     = writeSize,
+            .bytesReceived = readSize,
+            .cipherSuite   = SSL_get_cipher_name(stream.native_handle()),
+        };
+
+        // Keep the connection open for the next request of the user
+        if (kept != nullptr)
+        {
+            connection.stream = std::move(owner);
+            co_return result;
+        }
 
         // Gracefully close the stream
-        stream.shutdown(ec);
+        co_await stream.async_shutdown(boost::asio::redirect_error(boost::asio::use_awaitable, ec));
         if (ec and ec != boost::beast::net::ssl::error::stream_truncated)
         {
+            cause = FailureCause::SHUTDOWN;
             spdlog::error("Lily-PQC client SSL shutdown to server failed! Why: {}", ec.message());
+            co_return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+
+        co_return result;
+    }
+
+    boost::asio::awaitable<void> ClientConnection::writeBody(TlsStream& stream, uint64_t remaining,
+                                                             std::size_t& writeSize, boost::beast::error_code& ec) const
+    {
+        std::string_view chunk {std::string_view {this->serializedRequest}.substr(this->requestHeaderSize)};
+        while (remaining > 0 and !ec)
+        {
+            auto size {static_cast<std::size_t>(std::min<uint64_t>(remaining, chunk.size()))};
+            writeSize += co_await boost::asio::async_write(stream, boost::asio::buffer(chunk.data(), size),
+                                                           boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+            remaining -= size;
+        }
+    }
+
+    Expect<void> ClientConnection::sendControl(char const* target, std::string const& body)
+    {
+        // Variable that collect the error code thrown by boost function
+        boost::beast::error_code ec {};
+
+        // The control request runs on its own, outside of the users of a run
+        boost::asio::io_context ioc {};
+        boost::asio::ssl::stream<boost::beast::tcp_stream> stream {ioc, this->ctx};
+        std::ignore = boost::asio::connect(boost::beast::get_lowest_layer(stream).socket(), this->resolvedServer, ec);
+        if (ec)
+        {
+            spdlog::error("Lily-PQC client control connection to server failed! Why: {}", ec.message());
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+        if (this->sendServerName)
+            SSL_set_tlsext_host_name(stream.native_handle(), this->config.serverHost.c_str());
+        std::ignore = stream.handshake(boost::asio::ssl::stream_base::client, ec);
+        if (ec)
+        {
+            spdlog::error("Lily-PQC client control SSL handshake with server failed! Why: {}", ec.message());
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+
+        // Send the control request and wait for its response
+        boost::beast::http::request<boost::beast::http::string_body> req {boost::beast::http::verb::post, target, 11};
+        req.set(boost::beast::http::field::host, this->config.serverHost);
+        req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+        req.set(boost::beast::http::field::content_type, "text/plain");
+        req.keep_alive(false);
+        req.body() = body;
+        req.prepare_payload();
+        std::ignore = boost::beast::http::write(stream, req, ec);
+        if (ec)
+        {
+            spdlog::error("Lily-PQC client control SSL write to server failed! Why: {}", ec.message());
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+        boost::beast::flat_buffer buffer {};
+        boost::beast::http::response<boost::beast::http::string_body> res {};
+        std::ignore = boost::beast::http::read(stream, buffer, res, ec);
+        if (ec)
+        {
+            spdlog::error("Lily-PQC client control SSL read from server failed! Why: {}", ec.message());
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+        if (res.result() != boost::beast::http::status::ok)
+        {
+            spdlog::error("Lily-PQC server rejected the control request to {}! Is the control enabled? Status: {}",
+                          target, res.result_int());
             return ErrorCode::LILY_ERRORCODE_EXPECTED;
         }
 
+        // The server closes the connection after the response, so a truncated shutdown is expected
+        std::ignore = stream.shutdown(ec);
         return success;
     }
 } // namespace lily::net
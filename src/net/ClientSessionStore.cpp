@@ -0,0 +1,25 @@
+#include <lily/net/ClientSessionStore.h>
+
+namespace lily::net
+{
+    ClientSessionStore::ClientSessionStore(double resumptionRatio):
+        resumeDistribution {resumptionRatio}, generator {std::random_device {}()}
+    {
+    }
+
+    void ClientSessionStore::offer(SSL* ssl)
+    {
+        if (this->session and this->resumeDistribution(this->generator))
+            SSL_set_session(ssl, this->session.get());
+    }
+
+    void ClientSessionStore::update(SSL* ssl)
+    {
+        this->lastResumed = SSL_session_reused(ssl) == 1;
+
+        // In TLS 1.3 the session tickets arrive after the handshake, so the session is taken after the response is read
+        std::unique_ptr<SSL_SESSION, decltype(&SSL_SESSION_free)> newSession {SSL_get1_session(ssl), SSL_SESSION_free};
+        if (newSession and SSL_SESSION_is_resumable(newSession.get()) == 1)
+            this->session = std::move(newSession);
+    }
+} // namespace lily::net
@@ -0,0 +1,40 @@
+#include <lily/net/CryptoPool.h>
+
+namespace lily::net
+{
+    CryptoPool::CryptoPool(uint32_t threadCount): threads {threadCount} {}
+
+    void CryptoPool::onDequeue(std::chrono::steady_clock::time_point enqueueTime)
+    {
+        auto waitNs {static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                               std::chrono::steady_clock::now() - enqueueTime)
+                                               .count())};
+        this->queueDepth.fetch_sub(1, std::memory_order_relaxed);
+        this->totalJobs.fetch_add(1, std::memory_order_relaxed);
+        this->totalWaitNs.fetch_add(waitNs, std::memory_order_relaxed);
+
+        // Keep the longest wait of the current interval
+        auto maxWaitNs {this->maxWaitNs.load(std::memory_order_relaxed)};
+        while (waitNs > maxWaitNs and
+               !this->maxWaitNs.compare_exchange_weak(maxWaitNs, waitNs, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    CryptoPool::Metrics CryptoPool::collect()
+    {
+        auto jobs {this->totalJobs.load(std::memory_order_relaxed)};
+        auto waitNs {this->totalWaitNs.load(std::memory_order_relaxed)};
+        auto maxWaitNs {this->maxWaitNs.exchange(0, std::memory_order_relaxed)};
+
+        Metrics metrics {.queueDepth = this->queueDepth.load(std::memory_order_relaxed),
+                         .jobs       = jobs - this->lastJobs,
+                         .maxWaitUs  = static_cast<double>(maxWaitNs) / 1'000};
+        if (metrics.jobs > 0)
+            metrics.averageWaitUs = static_cast<double>(waitNs - this->lastWaitNs) / 1'000 / metrics.jobs;
+
+        this->lastJobs   = jobs;
+        this->lastWaitNs = waitNs;
+        return metrics;
+    }
+} // namespace lily::net
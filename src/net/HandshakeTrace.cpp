@@ -0,0 +1,124 @@
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <optional>
+
+#include <lily/log/TraceLog.h>
+#include <lily/net/CertCompression.h>
+#include <lily/net/HandshakeTrace.h>
+
+using namespace lily::log;
+
+namespace lily::net
+{
+    // Returns the traced phase of a handshake message
+    static std::optional<HandshakeTrace::Phase> getPhase(uint8_t messageType, bool sentByServer)
+    {
+        switch (messageType)
+        {
+        case SSL3_MT_CLIENT_HELLO:
+            return HandshakeTrace::Phase::CLIENT_HELLO;
+        case SSL3_MT_SERVER_HELLO:
+            return HandshakeTrace::Phase::SERVER_HELLO;
+        case SSL3_MT_ENCRYPTED_EXTENSIONS:
+            return HandshakeTrace::Phase::ENCRYPTED_EXTENSIONS;
+        case SSL3_MT_CERTIFICATE:
+#ifdef LILY_CERT_COMPRESSION
+        case SSL3_MT_COMPRESSED_CERTIFICATE:
+#endif
+            return HandshakeTrace::Phase::CERTIFICATE;
+        case SSL3_MT_CERTIFICATE_VERIFY:
+            return HandshakeTrace::Phase::CERTIFICATE_VERIFY;
+        case SSL3_MT_FINISHED:
+            return sentByServer ? HandshakeTrace::Phase::SERVER_FINISHED : HandshakeTrace::Phase::CLIENT_FINISHED;
+        default:
+            return std::nullopt;
+        }
+    }
+
+    void HandshakeTrace::onMessage(int writeP, int, int contentType, void const* buf, size_t length, SSL* ssl,
+                                   void* arg)
+    {
+        if (arg == nullptr or length == 0)
+            return;
+        auto& trace {*static_cast<HandshakeTrace*>(arg)};
+        if (trace.finished)
+            return trace.perf.update(writeP == 1 ? PerfSection::WRITE : PerfSection::READ);
+        trace.perf.update(PerfSection::HANDSHAKE);
+        trace.memory.update();
+
+        // Account every record on the wire from its header
+        if (contentType == SSL3_RT_HEADER and length >= SSL3_RT_HEADER_LENGTH)
+        {
+            auto const* header {static_cast<uint8_t const*>(buf)};
+            uint64_t recordSize {SSL3_RT_HEADER_LENGTH + (uint64_t {header[3]} << 8 | header[4])};
+            (writeP == 1 ? trace.accounting.bytesSent : trace.accounting.bytesReceived) += recordSize;
+            ++(writeP == 1 ? trace.accounting.recordsSent : trace.accounting.recordsReceived);
+            if (writeP != trace.lastDirection)
+                ++trace.accounting.flights;
+            trace.lastDirection = writeP;
+            return;
+        }
+
+        // The alerts and the application data are not traced
+        if (contentType != SSL3_RT_HANDSHAKE)
+            return;
+        auto sentByServer {(writeP == 1) == (SSL_is_server(ssl) == 1)};
+        auto phase {getPhase(*static_cast<uint8_t const*>(buf), sentByServer)};
+        if (!phase)
+            return;
+
+        // Keep the first occurrence only, a second ClientHello follows a HelloRetryRequest
+        auto& phaseUs {trace.phaseUs[static_cast<std::size_t>(*phase)]};
+        if (phaseUs == PHASE_NOT_SEEN)
+            phaseUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                            trace.beginTime)
+                          .count();
+    }
+
+    void HandshakeTrace::install(SSL_CTX* ctx)
+    {
+        SSL_CTX_set_msg_callback(ctx, &HandshakeTrace::onMessage);
+    }
+
+    void HandshakeTrace::attach(SSL* ssl)
+    {
+        this->phaseUs.fill(PHASE_NOT_SEEN);
+        this->accounting    = {};
+        this->lastDirection = -1;
+        this->finished      = false;
+        this->beginTime = std::chrono::steady_clock::now();
+        this->memory.begin();
+        this->perf.begin();
+        SSL_set_msg_callback_arg(ssl, this);
+    }
+
+    void HandshakeTrace::finish(int socket)
+    {
+        this->finished = true;
+        this->perf.update(PerfSection::HANDSHAKE);
+        this->memory.update();
+        auto const& usage {this->memory.getUsage()};
+        this->accounting.memBytes       = usage.allocatedBytes;
+        this->accounting.memPeak        = usage.peakBytes;
+        this->accounting.memAllocations = usage.allocations;
+
+        tcp_info info {};
+        socklen_t infoLength {sizeof(info)};
+        if (getsockopt(socket, IPPROTO_TCP, TCP_INFO, &info, &infoLength) < 0)
+            return;
+        this->accounting.rttUs       = info.tcpi_rtt;
+        this->accounting.retransmits = info.tcpi_total_retrans;
+    }
+
+    void HandshakeTrace::write(uint64_t connectionId) const
+    {
+        TraceLog::getInstance().write({.connId                = connectionId,
+                                       .clientHelloUs         = this->getPhaseUs(Phase::CLIENT_HELLO),
+                                       .serverHelloUs         = this->getPhaseUs(Phase::SERVER_HELLO),
+                                       .encryptedExtensionsUs = this->getPhaseUs(Phase::ENCRYPTED_EXTENSIONS),
+                                       .certificateUs         = this->getPhaseUs(Phase::CERTIFICATE),
+                                       .certificateVerifyUs   = this->getPhaseUs(Phase::CERTIFICATE_VERIFY),
+                                       .serverFinishedUs      = this->getPhaseUs(Phase::SERVER_FINISHED),
+                                       .clientFinishedUs      = this->getPhaseUs(Phase::CLIENT_FINISHED)});
+    }
+} // namespace lily::net
@@ -0,0 +1,319 @@
+#include <algorithm>
+#include <condition_variable>
+#include <fmt/color.h>
+#include <fmt/core.h>
+#include <functional>
+#include <mutex>
+#include <spdlog/spdlog.h>
+#include <sys/resource.h>
+#include <thread>
+
+#include <lily/core/Constants.h>
+#include <lily/log/ClientLog.h>
+#include <lily/net/LoadGenerator.h>
+
+using namespace lily::core;
+using namespace lily::log;
+
+namespace lily::net
+{
+    LoadGenerator::LoadGenerator(LoadConfig const& config): config {config} {}
+
+    std::chrono::steady_clock::time_point LoadGenerator::Timetable::take()
+    {
+        if (this->nextSlot == std::chrono::steady_clock::time_point {})
+            this->nextSlot = std::chrono::steady_clock::now();
+
+        auto slot {this->nextSlot};
+        auto gap {this->meanInterval};
+        if (this->arrival == ArrivalProcess::POISSON)
+            gap *= this->gapDistribution(this->generator);
+        this->nextSlot += std::chrono::duration_cast<std::chrono::steady_clock::duration>(gap);
+        return slot;
+    }
+
+    // The CPU time used by every thread of the process so far
+    static std::chrono::microseconds getCpuTime()
+    {
+        rusage usage {};
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+            return {};
+        return std::chrono::seconds {usage.ru_utime.tv_sec + usage.ru_stime.tv_sec} +
+               std::chrono::microseconds {usage.ru_utime.tv_usec + usage.ru_stime.tv_usec};
+    }
+
+    // Print the failed requests by cause, skipping the causes that never occurred
+    template<typename Count>
+    static void printFailures(std::array<Count, FAILURE_CAUSE_COUNT> const& failures)
+    {
+        std::string breakdown {};
+        for (std::size_t i {}; i < FAILURE_CAUSE_COUNT; ++i)
+            if (uint64_t count {failures[i]}; count > 0)
+                breakdown += fmt::format("{}{} {}", breakdown.empty() ? "" : " | ", FAILURE_CAUSE_NAMES[i], count);
+        if (!breakdown.empty())
+            fmt::print("[-] Failed Request by cause: {}\r\n", breakdown);
+    }
+
+    boost::asio::awaitable<void> LoadGenerator::runUser(ClientConnection& connection, Timetable* timetable,
+                                                        UserTraffic& traffic)
+    {
+        // Every user keeps its own session ticket, and its own connection in the keep-alive mode
+        ClientSessionStore sessionStore {this->config.client.resumptionRatio};
+        KeptConnection kept {};
+        auto keepAlive {this->config.client.keepAlive};
+        boost::asio::steady_timer timer {co_await boost::asio::this_coro::executor};
+        boost::beast::error_code ec {};
+
+        // Send dummy data repeatedly
+        while (true)
+        {
+            // Wait for the next slot of the timetable. A slot taken after its time is missed, because every user of
+            // the thread was still busy or the thread could not keep up.
+            std::optional<std::chrono::steady_clock::time_point> intendedStart {};
+            if (timetable != nullptr)
+            {
+                intendedStart = timetable->take();
+                timer.expires_at(*intendedStart);
+                co_await timer.async_wait(boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+                if (std::chrono::steady_clock::now() - *intendedStart > constants::OPEN_LOOP_SLOT_TOLERANCE)
+                    ++this->totalMissedSlot;
+            }
+
+            FailureCause failure {};
+            auto result {co_await connection.sendDummyData(sessionStore, intendedStart, keepAlive ? &kept : nullptr,
+                                                           &failure)};
+            if (!result)
+            {
+                ++this->totalFailedRequest;
+                this->totalFailures[static_cast<std::size_t>(failure)].fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                ++this->totalSuccessfulRequest;
+                auto const& [handshake, bytesSent, bytesReceived, cipherSuite] {result.value()};
+                if (handshake)
+                {
+                    if (sessionStore.wasResumed())
+                        ++this->totalResumedRequest;
+                    ++this->totalHandshake;
+                    this->totalHandshakeBytesSent.fetch_add(handshake->bytesSent, std::memory_order_relaxed);
+                    this->totalHandshakeBytesRecv.fetch_add(handshake->bytesReceived, std::memory_order_relaxed);
+                }
+                this->totalBytesSent.fetch_add(bytesSent, std::memory_order_relaxed);
+                this->totalBytesRecv.fetch_add(bytesReceived, std::memory_order_relaxed);
+                traffic.bytes += bytesSent + bytesReceived;
+                ++traffic.cipherSuites[cipherSuite];
+            }
+
+            // Stop every user once the request limit is reached, the requests still in flight are abandoned
+            if (this->config.requestLimit > 0 and
+                static_cast<uint64_t>(this->totalSuccessfulRequest + this->totalFailedRequest) >=
+                    this->config.requestLimit)
+                co_return this->stop();
+        }
+    }
+
+    void LoadGenerator::stop()
+    {
+        for (auto& ioc: this->contexts)
+            ioc->stop();
+    }
+
+    void LoadGenerator::printTotalRequest(std::stop_token stopToken)
+    {
+        auto startTime {std::chrono::high_resolution_clock::now()};
+        auto startCpuTime {getCpuTime()};
+
+        // Wake up early when the run stops
+        std::mutex mtx {};
+        std::condition_variable_any stopped {};
+        std::unique_lock lock {mtx};
+        while (!stopped.wait_for(lock, stopToken, constants::STATS_REPORT_INTERVAL,
+                                 [&stopToken] { return stopToken.stop_requested(); }))
+        {
+            auto elapsedTime {std::chrono::high_resolution_clock::now() - startTime};
+            fmt::print("[-] Successful Request: {} | Failed Request: {} | Resumed Request: {} | TPS : {:.2f} req/s\r\n",
+                       this->totalSuccessfulRequest.load(), this->totalFailedRequest.load(),
+                       this->totalResumedRequest.load(),
+                       static_cast<double>(this->totalSuccessfulRequest.load() + this->totalFailedRequest.load()) /
+                           std::chrono::duration_cast<std::chrono::seconds>(elapsedTime).count());
+            if (this->config.rate > 0)
+                fmt::print("[-] Offered Load: {:.2f} req/s | Missed Slot: {}\r\n", this->config.rate,
+                           this->totalMissedSlot.load());
+            printFailures(this->totalFailures);
+            if (this->config.client.keepAlive)
+            {
+                std::chrono::duration<double> elapsedSeconds {elapsedTime};
+                std::chrono::duration<double> cpuSeconds {getCpuTime() - startCpuTime};
+                fmt::print("[-] Throughput: sent {:.2f} MB/s | received {:.2f} MB/s | CPU {:.1f}%\r\n",
+                           this->totalBytesSent.load() / elapsedSeconds.count() / 1e6,
+                           this->totalBytesRecv.load() / elapsedSeconds.count() / 1e6,
+                           100.0 * cpuSeconds.count() / elapsedSeconds.count());
+            }
+            LatencyRecorder::print(*ClientLog::getInstance().getLatencyRecorder().collect());
+        }
+    }
+
+    Expect<void> LoadGenerator::run()
+    {
+        // Configure the SSL context and resolve the server once for the whole run
+        BOOST_OUTCOME_TRY(decltype(auto) connection, ClientConnection::create(this->config.client));
+        fmt::print("[-] Client set-up done once instead of per request: SSL context {} us | Resolve {} us\r\n",
+                   connection.getContextSetupDuration().count(), connection.getResolveDuration().count());
+
+        // Every user holds a socket, so raise the open files limit as far as allowed
+        rlimit openFiles {};
+        if (getrlimit(RLIMIT_NOFILE, &openFiles) == 0 and openFiles.rlim_cur < openFiles.rlim_max)
+        {
+            openFiles.rlim_cur = openFiles.rlim_max;
+            std::ignore        = setrlimit(RLIMIT_NOFILE, &openFiles);
+        }
+        if (openFiles.rlim_cur < this->config.concurrentUsers)
+            spdlog::warn("The open files limit ({}) is lower than the number of concurrent users", openFiles.rlim_cur);
+
+        // Every run starts from zero, the latencies of the previous runs are subtracted at the end
+        this->totalSuccessfulRequest  = 0;
+        this->totalFailedRequest      = 0;
+        this->totalResumedRequest     = 0;
+        this->totalMissedSlot         = 0;
+        for (auto& failures: this->totalFailures)
+            failures = 0;
+        this->totalHandshakeBytesSent = 0;
+        this->totalHandshakeBytesRecv = 0;
+        this->totalHandshake          = 0;
+        this->totalBytesSent          = 0;
+        this->totalBytesRecv          = 0;
+        this->interrupted             = false;
+        auto& clientLog {ClientLog::getInstance()};
+        auto previousHistograms {clientLog.getLatencyRecorder().snapshot()};
+
+        // Each thread runs its own `io_context`, so the users never need a strand
+        this->contexts.clear();
+        for (uint32_t i {}; i < this->config.clientThreads; ++i)
+            this->contexts.emplace_back(std::make_unique<boost::asio::io_context>(1));
+
+        // In the open-loop mode, every thread follows its own timetable with an even share of the offered load
+        std::vector<Timetable> timetables {};
+        if (this->config.rate > 0)
+        {
+            timetables.reserve(this->contexts.size());
+            for (std::size_t i {}; i < this->contexts.size(); ++i)
+                timetables.emplace_back(this->config.arrival, this->config.rate / this->contexts.size());
+        }
+
+        // Set-up concurrent users pool, spread evenly across the threads
+        this->userTraffic = std::vector<UserTraffic>(this->config.concurrentUsers);
+        for (uint32_t i {}; i < this->config.concurrentUsers; ++i)
+        {
+            auto thread {i % this->contexts.size()};
+            boost::asio::co_spawn(
+                *this->contexts[thread],
+                this->runUser(connection, timetables.empty() ? nullptr : &timetables[thread], this->userTraffic[i]),
+                boost::asio::detached);
+        }
+
+        auto startTime {std::chrono::steady_clock::now()};
+        auto startCpuTime {getCpuTime()};
+        {
+            // Stop every user on interruption or termination
+            boost::asio::signal_set signals {*this->contexts.front(), SIGINT, SIGTERM};
+            signals.async_wait(
+                [this](boost::beast::error_code ec, int)
+                {
+                    if (ec)
+                        return;
+                    this->interrupted = true;
+                    this->stop();
+                });
+
+            // Stop every user once the duration elapses
+            boost::asio::steady_timer deadline {*this->contexts.front()};
+            if (this->config.duration.count() > 0)
+            {
+                deadline.expires_after(this->config.duration);
+                deadline.async_wait(
+                    [this](boost::beast::error_code ec)
+                    {
+                        if (!ec)
+                            this->stop();
+                    });
+            }
+
+            std::jthread totalRequestPrinter {std::bind_front(&LoadGenerator::printTotalRequest, this)};
+
+            fmt::print(fmt::fg(fmt::color::green), "[v] All users is active and testing the server!\r\n");
+
+            std::vector<std::jthread> userThreads {};
+            for (auto& ioc: this->contexts)
+                userThreads.emplace_back([ioc = ioc.get()] { ioc->run(); });
+            for (auto& thread: userThreads)
+                thread.join();
+            totalRequestPrinter.request_stop();
+            totalRequestPrinter.join();
+        }
+        auto elapsedTime {std::chrono::steady_clock::now() - startTime};
+        auto cpuTime {getCpuTime() - startCpuTime};
+
+        // Destroy the users abandoned in flight while the engine they use is still alive
+        this->contexts.clear();
+
+        // Summarize the run, keeping only the latencies recorded by its own requests
+        this->summary = {
+            .successfulRequests = static_cast<uint64_t>(this->totalSuccessfulRequest.load()),
+            .failedRequests     = static_cast<uint64_t>(this->totalFailedRequest.load()),
+            .resumedRequests    = static_cast<uint64_t>(this->totalResumedRequest.load()),
+            .missedSlots        = static_cast<uint64_t>(this->totalMissedSlot.load()),
+            .elapsed            = std::chrono::duration_cast<std::chrono::microseconds>(elapsedTime),
+            .handshakes         = this->totalHandshake.load(),
+            .hsBytesSent        = this->totalHandshakeBytesSent.load(),
+            .hsBytesRecv        = this->totalHandshakeBytesRecv.load(),
+            .bytesSent          = this->totalBytesSent.load(),
+            .bytesRecv          = this->totalBytesRecv.load(),
+            .cpuTime            = cpuTime,
+            .latency            = clientLog.getLatencyRecorder().snapshot(),
+            .interrupted        = this->interrupted.load(),
+        };
+        std::chrono::duration<double> elapsedSeconds {elapsedTime};
+        for (std::size_t i {}; i < FAILURE_CAUSE_COUNT; ++i)
+            this->summary.failures[i] = this->totalFailures[i].load();
+        for (auto const& traffic: this->userTraffic)
+        {
+            this->summary.userThroughput.push_back(traffic.bytes / elapsedSeconds.count() / 1e6);
+            for (auto const& [cipherSuite, requests]: traffic.cipherSuites)
+                this->summary.cipherSuites[cipherSuite == nullptr ? "unknown" : cipherSuite] += requests;
+        }
+        this->userTraffic.clear();
+        for (std::size_t i {}; i < LatencyRecorder::METRIC_COUNT; ++i)
+            (*this->summary.latency)[i] -= (*previousHistograms)[i];
+        return success;
+    }
+
+    void LoadGenerator::report() const
+    {
+        // Summarize the latencies of the whole run
+        auto& clientLog {ClientLog::getInstance()};
+        fmt::print(fmt::fg(fmt::color::green), "[v] Client stopped! Latency of the whole run:\r\n");
+        LatencyRecorder::print(*this->summary.latency);
+        clientLog.dumpHistograms(*this->summary.latency);
+
+        // Summarize the traffic of the whole run, over the HTTP bytes of the successful requests
+        std::chrono::duration<double> elapsed {this->summary.elapsed};
+        std::chrono::duration<double> cpuTime {this->summary.cpuTime};
+        if (elapsed.count() > 0)
+            fmt::print("[-] Throughput: sent {:.2f} MB/s | received {:.2f} MB/s | CPU {:.1f}%\r\n",
+                       this->summary.bytesSent / elapsed.count() / 1e6,
+                       this->summary.bytesRecv / elapsed.count() / 1e6, 100.0 * cpuTime.count() / elapsed.count());
+        if (this->config.client.keepAlive and !this->summary.userThroughput.empty())
+        {
+            auto throughput {this->summary.userThroughput};
+            std::ranges::sort(throughput);
+            fmt::print("[-] Throughput per connection: min {:.2f} MB/s | p50 {:.2f} MB/s | max {:.2f} MB/s\r\n",
+                       throughput.front(), throughput[throughput.size() / 2], throughput.back());
+        }
+        for (auto const& [cipherSuite, requests]: this->summary.cipherSuites)
+            fmt::print("[-] Cipher suite {}: {} requests\r\n", cipherSuite, requests);
+        printFailures(this->summary.failures);
+        if (auto dropped {clientLog.getDroppedRecords()}; dropped > 0)
+            spdlog::warn("{} client log records were dropped because the log buffer was full", dropped);
+    }
+} // namespace lily::net
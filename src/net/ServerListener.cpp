@@ -1,32 +1,53 @@
+#include <algorithm>
+#include <condition_variable>
+#include <fmt/color.h>
+#include <fmt/core.h>
+#include <functional>
+#include <mutex>
+#include <netinet/tcp.h>
+#include <openssl/rand.h>
 #include <spdlog/spdlog.h>
 #include <thread>
 
 #include <lily/core/Constants.h>
 #include <lily/crypto/OQSLoader.h>
+#include <lily/log/ServerLog.h>
+#include <lily/net/CertCompression.h>
+#include <lily/net/HandshakeTrace.h>
 #include <lily/net/ServerListener.h>
 #include <lily/net/ServerSession.h>
+#include <lily/net/TlsStream.h>
 
 using namespace lily::core;
+using namespace lily::log;
 
 namespace lily::net
 {
-    ServerListener::ServerListener(uint16_t port):
-        ioc {std::make_unique<boost::beast::net::io_context>(1)}, ctx {boost::asio::ssl::context::tlsv13_server},
-        endpoint {boost::asio::ip::make_address(constants::DEFAULT_SERVER_HOST), port}, acceptor {*ioc.get()}
+    ServerListener::ServerListener(ServerConfig const& config):
+        ctx {boost::asio::ssl::context::tlsv13_server},
+        endpoint {boost::asio::ip::make_address(constants::DEFAULT_SERVER_HOST), config.port},
+        traceHandshake {config.traceHandshake}, enableControl {config.enableControl}, ktls {config.ktls},
+        socketOptions {config.socketOptions}
     {
+        // Spread the worker threads evenly, every shard runs at least one thread
+        for (uint32_t i {}; i < config.acceptorShards; ++i)
+            this->shards.emplace_back(std::make_unique<AcceptorShard>(
+                std::max(config.workerThreads / config.acceptorShards +
+                             (i < config.workerThreads % config.acceptorShards ? 1 : 0),
+                         1u)));
+
+        // The handshakes are offloaded only when a crypto pool is requested
+        if (config.cryptoThreads > 0)
+            this->cryptoPool = std::make_unique<CryptoPool>(config.cryptoThreads);
     }
 
-    Expect<ServerListener> ServerListener::create(uint16_t port, std::filesystem::path const& serverCertificatePath,
-                                                  std::filesystem::path const& privateKeyPath)
+    Expect<void> ServerListener::listen(AcceptorShard& shard, bool reusePort)
     {
-        // Create the `ServerListener` default instance
-        ServerListener listener {port};
-
         // Variable that collect the error code thrown by boost function
         boost::beast::error_code ec {};
 
         // Open the socket communication
-        std::ignore = listener.acceptor.open(listener.endpoint.protocol(), ec);
+        std::ignore = shard.acceptor.open(this->endpoint.protocol(), ec);
         if (ec)
         {
             spdlog::error("Lily-PQC server connection open failed! Why: {}", ec.message());
@@ -34,54 +55,70 @@ namespace lily::net
         }
 
         // Allow address reuse
-        std::ignore = listener.acceptor.set_option(boost::beast::net::socket_base::reuse_address(true), ec);
+        std::ignore = shard.acceptor.set_option(boost::beast::net::socket_base::reuse_address(true), ec);
         if (ec)
         {
             spdlog::error("Lily-PQC server connection set_option failed! Why: {}", ec.message());
             return ErrorCode::LILY_ERRORCODE_EXPECTED;
         }
 
-        // Bind to the server address
-        std::ignore = listener.acceptor.bind(listener.endpoint, ec);
-        if (ec)
+        // Allow several acceptors to bind the same port, the kernel balances the connections across them
+        if (reusePort)
         {
-            spdlog::error("Lily-PQC server connection bind failed! Why: {}", ec.message());
-            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+            using reuse_port = boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+            std::ignore      = shard.acceptor.set_option(reuse_port(true), ec);
+            if (ec)
+            {
+                spdlog::error("Lily-PQC server connection set_option SO_REUSEPORT failed! Why: {}", ec.message());
+                return ErrorCode::LILY_ERRORCODE_EXPECTED;
+            }
         }
 
-        // Start listening for connections
-        std::ignore = listener.acceptor.listen(boost::beast::net::socket_base::max_listen_connections, ec);
-        if (ec)
+        // Accept the data sent with the SYN by the clients holding a cookie, up to the given pending connections
+        if (this->socketOptions.fastOpen)
         {
-            spdlog::error("Lily-PQC server connection listen failed! Why: {}", ec.message());
-            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+            using fast_open = boost::asio::detail::socket_option::integer<IPPROTO_TCP, TCP_FASTOPEN>;
+            std::ignore     = shard.acceptor.set_option(fast_open(constants::TCP_FASTOPEN_QUEUE_LENGTH), ec);
+            if (ec)
+            {
+                spdlog::error("Lily-PQC server connection set_option TCP_FASTOPEN failed! Why: {}", ec.message());
+                return ErrorCode::LILY_ERRORCODE_EXPECTED;
+            }
         }
 
-        // Load the certificate
-        std::ignore = listener.ctx.use_certificate_chain_file(serverCertificatePath, ec);
+        // Bind to the server address
+        std::ignore = shard.acceptor.bind(this->endpoint, ec);
         if (ec)
         {
-            spdlog::error("Lily-PQC server context use_certificate_chain_file failed! Why: {}\r\n", ec.message());
+            spdlog::error("Lily-PQC server connection bind failed! Why: {}", ec.message());
             return ErrorCode::LILY_ERRORCODE_EXPECTED;
         }
 
-        // Load the private key
-        std::ignore = listener.ctx.use_private_key_file(privateKeyPath, boost::asio::ssl::context::pem, ec);
+        // Start listening for connections
+        std::ignore = shard.acceptor.listen(boost::beast::net::socket_base::max_listen_connections, ec);
         if (ec)
         {
-            spdlog::error("Lily-PQC server context use_certificate_chain_file failed! Why: {}\r\n", ec.message());
+            spdlog::error("Lily-PQC server connection listen failed! Why: {}", ec.message());
             return ErrorCode::LILY_ERRORCODE_EXPECTED;
         }
+        return success;
+    }
+
+    Expect<void> ServerListener::configureContext(boost::asio::ssl::context& ctx, ServerConfig const& config,
+                                                  std::vector<int> const& compression, bool compressChain)
+    {
+        // Variable that collect the error code thrown by boost function
+        boost::beast::error_code ec {};
 
         // Check whether the private key and certificate match or not
-        if (SSL_CTX_check_private_key(listener.ctx.native_handle()) <= 0)
+        if (SSL_CTX_check_private_key(ctx.native_handle()) <= 0)
         {
             spdlog::error("Lily-PQC server private key and certificate mismatch! Cause: SSL_CTX_check_private_key");
             return ErrorCode::LILY_ERRORCODE_EXPECTED;
         }
 
         // Disable the verification. The verification will only be necessary for mutual TLS.
-        std::ignore = listener.ctx.set_verify_mode(boost::asio::ssl::verify_none, ec);
+        std::ignore = ctx.set_verify_mode(boost::asio::ssl::verify_none, ec);
         if (ec)
         {
             spdlog::error("Lily-PQC server context set_verify_mode failed! Why: {}", ec.message());
@@ -90,52 +127,261 @@ namespace lily::net
 
         // Configure the session id to avoid undefined session id context
         constexpr std::array<uint8_t, SSL_MAX_SID_CTX_LENGTH> sessionId {};
-        if (SSL_CTX_set_session_id_context(listener.ctx.native_handle(), sessionId.data(), sessionId.size()) <= 0)
+        if (SSL_CTX_set_session_id_context(ctx.native_handle(), sessionId.data(), sessionId.size()) <= 0)
         {
             spdlog::error("Lily-PQC server context set_session_id_context failed!");
             return ErrorCode::LILY_ERRORCODE_EXPECTED;
         }
 
+        // Configure the TLS 1.3 session tickets issued after every full handshake
+        if (config.sessionTickets > 0)
+        {
+            // Set up the ticket keys explicitly, so every handshake accepted by this listener shares the same keys
+            std::array<uint8_t, 80> ticketKeys {};
+            if (RAND_bytes(ticketKeys.data(), ticketKeys.size()) <= 0 or
+                SSL_CTX_set_tlsext_ticket_keys(ctx.native_handle(), ticketKeys.data(), ticketKeys.size()) <= 0)
+            {
+                spdlog::error("Lily-PQC server context set session ticket keys failed! Cause: "
+                              "SSL_CTX_set_tlsext_ticket_keys");
+                return ErrorCode::LILY_ERRORCODE_EXPECTED;
+            }
+            SSL_CTX_set_session_cache_mode(ctx.native_handle(), SSL_SESS_CACHE_SERVER);
+            SSL_CTX_set_timeout(ctx.native_handle(), config.sessionTicketLifetime.count());
+        }
+        else
+            SSL_CTX_set_options(ctx.native_handle(), SSL_OP_NO_TICKET);
+        if (SSL_CTX_set_num_tickets(ctx.native_handle(), config.sessionTickets) <= 0)
+        {
+            spdlog::error(
+                "Lily-PQC server context set number of session tickets failed! Cause: SSL_CTX_set_num_tickets");
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+
         // Only allow TLS 1.3 for communication
-        SSL_CTX_set_options(listener.ctx.native_handle(),
-                            SSL_OP_ALLOW_CLIENT_RENEGOTIATION | SSL_OP_CIPHER_SERVER_PREFERENCE);
-        SSL_CTX_set_min_proto_version(listener.ctx.native_handle(), TLS1_3_VERSION);
-        SSL_CTX_set_max_proto_version(listener.ctx.native_handle(), TLS1_3_VERSION);
+        SSL_CTX_set_options(ctx.native_handle(), SSL_OP_ALLOW_CLIENT_RENEGOTIATION | SSL_OP_CIPHER_SERVER_PREFERENCE);
+        SSL_CTX_set_min_proto_version(ctx.native_handle(), TLS1_3_VERSION);
+        SSL_CTX_set_max_proto_version(ctx.native_handle(), TLS1_3_VERSION);
+
+        // Limit the plaintext carried by every record sent
+        if (config.maxRecordSize > 0 and SSL_CTX_set_max_send_fragment(ctx.native_handle(), config.maxRecordSize) <= 0)
+        {
+            spdlog::error("Lily-PQC server context set max record size failed! It must be between 512 and 16384");
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+
+        // Hand the records over to the kernel once the handshake completes
+        if (config.ktls)
+        {
+            BOOST_OUTCOME_TRY(TlsStream::enableKtls(ctx.native_handle()));
+        }
 
         // Set the key exchange algorithm
-        if (SSL_CTX_set1_groups_list(listener.ctx.native_handle(), constants::SUPPORTED_PQC_GROUPS_LIST) <= 0)
+        if (SSL_CTX_set1_groups_list(ctx.native_handle(), constants::SUPPORTED_PQC_GROUPS_LIST) <= 0)
         {
             spdlog::error("Lily-PQC server context set key exchange algorithm failed! Cause: SSL_CTX_set1_groups_list");
             return ErrorCode::LILY_ERRORCODE_EXPECTED;
         }
 
         // Set the supported signature algorithm
-        if (SSL_CTX_set1_sigalgs_list(listener.ctx.native_handle(), constants::SUPPORTED_SIGALGS_LIST) <= 0)
+        if (SSL_CTX_set1_sigalgs_list(ctx.native_handle(), constants::SUPPORTED_SIGALGS_LIST) <= 0)
         {
             spdlog::error(
                 "Lily-PQC server context set supported signature algorithm failed! Cause: SSL_CTX_set1_sigalgs_list");
             return ErrorCode::LILY_ERRORCODE_EXPECTED;
         }
 
-        return listener;
+        // Compress the certificate chain once, every handshake then serves the same compressed chain
+        BOOST_OUTCOME_TRY(configureCertCompression(ctx.native_handle(), compression));
+        if (compressChain)
+        {
+            BOOST_OUTCOME_TRY(compressCertificate(ctx.native_handle(), compression));
+        }
+
+        // Account the handshake bytes of every connection, and time the handshake messages of the traced ones
+        HandshakeTrace::install(ctx.native_handle());
+        return success;
     }
 
-    void ServerListener::run()
+    Expect<ServerListener> ServerListener::create(ServerConfig const& config)
     {
+        // Create the `ServerListener` default instance
+        ServerListener listener {config};
+
         // Variable that collect the error code thrown by boost function
         boost::beast::error_code ec {};
 
-        while (true)
+        // Open the acceptor of every shard
+        for (auto& shard: listener.shards)
         {
-            // This will receive the new connection
-            boost::asio::ip::tcp::socket socket {this->ioc->get_executor()};
+            BOOST_OUTCOME_TRY(listener.listen(*shard, listener.shards.size() > 1));
+        }
 
-            // Block until we get a connection
-            std::ignore = this->acceptor.accept(socket, ec);
-            if (ec)
-                spdlog::error("Lily-PQC server context accept failed! Why: {}", ec.message());
+        // Every certificate needs its own private key
+        if (config.certificatePaths.empty() or config.certificatePaths.size() != config.privateKeyPaths.size())
+        {
+            spdlog::error("Lily-PQC server needs as many private keys as certificates, and at least one of each");
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+
+        // Load the first certificate, served when no other is usable
+        std::ignore = listener.ctx.use_certificate_chain_file(config.certificatePaths.front(), ec);
+        if (ec)
+        {
+            spdlog::error("Lily-PQC server context use_certificate_chain_file failed! Why: {}\r\n", ec.message());
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+
+        // Load the private key
+        std::ignore =
+            listener.ctx.use_private_key_file(config.privateKeyPaths.front(), boost::asio::ssl::context::pem, ec);
+        if (ec)
+        {
+            spdlog::error("Lily-PQC server context use_certificate_chain_file failed! Why: {}\r\n", ec.message());
+            return ErrorCode::LILY_ERRORCODE_EXPECTED;
+        }
+
+        // Configure the TLS 1.3 settings shared by every connection. With several certificates, the store serves
+        // them all and compresses each of them, so the chain of the context is not compressed.
+        BOOST_OUTCOME_TRY(decltype(auto) compression, parseCertCompression(config.certCompression));
+        BOOST_OUTCOME_TRY(configureContext(listener.ctx, config, compression, config.certificatePaths.size() == 1));
+
+        // The store compresses the certificates it holds with the same algorithms as the context
+        listener.certificates = std::make_unique<CertificateStore>(std::move(compression));
+
+        // Preload every certificate once, the one matching the client is then selected during every handshake
+        if (config.certificatePaths.size() > 1)
+        {
+            CertificateStore::CredentialsList credentials {};
+            for (std::size_t i {}; i < config.certificatePaths.size(); ++i)
+            {
+                BOOST_OUTCOME_TRY(decltype(auto) entry,
+                                  listener.certificates->load(config.certificatePaths[i], config.privateKeyPaths[i]));
+                credentials.push_back(entry);
+            }
+            listener.certificates->replace(std::move(credentials));
+        }
+
+        // Select among the preloaded certificates or the ones replaced through the control target, if any
+        listener.certificates->install(listener.ctx.native_handle());
+        return listener;
+    }
+
+    void ServerListener::run()
+    {
+        // Start accepting connections before the worker threads are running
+        for (auto& shard: this->shards)
+            this->doAccept(*shard);
+
+        // Stop every shard on interruption or termination
+        boost::asio::signal_set signals {*this->shards.front()->ioc, SIGINT, SIGTERM};
+        signals.async_wait(
+            [this](boost::beast::error_code, int)
+            {
+                for (auto& shard: this->shards)
+                    shard->ioc->stop();
+            });
+
+        // Report the latencies, how the connections are balanced and how busy the crypto pool is
+        std::jthread reporter {std::bind_front(&ServerListener::report, this)};
+
+        // Run the `io_context` of every shard on its worker threads
+        std::vector<std::jthread> workers {};
+        for (auto& shard: this->shards)
+            for (uint32_t i {}; i < shard->threads; ++i)
+                workers.emplace_back([ioc = shard->ioc.get()] { ioc->run(); });
+        for (auto& worker: workers)
+            worker.join();
+        reporter.request_stop();
+        reporter.join();
+
+        // Summarize the latencies of the whole run
+        auto& serverLog {ServerLog::getInstance()};
+        auto histograms {serverLog.getLatencyRecorder().snapshot()};
+        fmt::print(fmt::fg(fmt::color::green), "[v] Server stopped! Latency of the whole run:\r\n");
+        LatencyRecorder::print(*histograms);
+        serverLog.dumpHistograms(*histograms);
+        if (auto dropped {serverLog.getDroppedRecords()}; dropped > 0)
+            spdlog::warn("{} server log records were dropped because the log buffer was full", dropped);
+    }
+
+    void ServerListener::doAccept(AcceptorShard& shard)
+    {
+        // The new connection gets its own strand, so its handlers never run concurrently
+        shard.acceptor.async_accept(boost::asio::make_strand(*shard.ioc.get()),
+                                    boost::beast::bind_front_handler(&ServerListener::onAccept, this, std::ref(shard)));
+    }
+
+    void ServerListener::onAccept(AcceptorShard& shard, boost::beast::error_code ec,
+                                  boost::asio::ip::tcp::socket socket)
+    {
+        // The acceptor was closed, the server is stopping
+        if (ec == boost::asio::error::operation_aborted)
+            return;
+
+        if (ec)
+        {
+            spdlog::error("Lily-PQC server context accept failed! Why: {}", ec.message());
+
+            // Back off before accepting again, as the error may last until some connections are closed
+            shard.retryTimer.expires_after(constants::ACCEPT_RETRY_DELAY);
+            shard.retryTimer.async_wait(
+                [this, &shard](boost::beast::error_code timerEc)
+                {
+                    if (!timerEc)
+                        this->doAccept(shard);
+                });
+            return;
+        }
+
+        if (applySocketOptions(socket, this->socketOptions))
+        {
+            shard.totalAccepted.fetch_add(1, std::memory_order_relaxed);
+            std::make_shared<ServerSession>(std::move(socket), this->ctx, this->cryptoPool.get(), this->traceHandshake,
+                                            this->enableControl ? this->certificates.get() : nullptr, this->ktls)
+                ->run();
+        }
+
+        // Accept another connection
+        this->doAccept(shard);
+    }
+
+    void ServerListener::report(std::stop_token stopToken)
+    {
+        std::vector<uint64_t> lastAccepted(this->shards.size());
+
+        // Wake up early when the server stops
+        std::mutex mtx {};
+        std::condition_variable_any stopped {};
+        std::unique_lock lock {mtx};
+        while (!stopped.wait_for(lock, stopToken, constants::STATS_REPORT_INTERVAL,
+                                 [&stopToken] { return stopToken.stop_requested(); }))
+        {
+            LatencyRecorder::print(*ServerLog::getInstance().getLatencyRecorder().collect());
+
+            if (this->cryptoPool)
+            {
+                auto metrics {this->cryptoPool->collect()};
+                fmt::print(
+                    "[-] Crypto Pool | Queue Depth: {} | Jobs: +{} | Avg Wait: {:.2f} us | Max Wait: {:.2f} us\r\n",
+                    metrics.queueDepth, metrics.jobs, metrics.averageWaitUs, metrics.maxWaitUs);
+            }
+
+            for (std::size_t i {}; this->shards.size() > 1 and i < this->shards.size(); ++i)
+            {
+                auto& shard {*this->shards[i]};
+
+                // On a listening socket, `tcpi_unacked` holds the current accept queue length and `tcpi_sacked` the
+                // configured backlog
+                tcp_info info {};
+                socklen_t infoLength {sizeof(info)};
+                if (getsockopt(shard.acceptor.native_handle(), IPPROTO_TCP, TCP_INFO, &info, &infoLength) < 0)
+                    info = {};
 
-            std::jthread {std::bind(&ServerSession::run, ServerSession {std::move(socket), this->ctx})}.detach();
+                auto totalAccepted {shard.totalAccepted.load(std::memory_order_relaxed)};
+                fmt::print("[-] Shard {} | Accepted: {} (+{}) | Accept Queue: {}/{}\r\n", i, totalAccepted,
+                           totalAccepted - lastAccepted[i], info.tcpi_unacked, info.tcpi_sacked);
+                lastAccepted[i] = totalAccepted;
+            }
         }
     }
 } // namespace lily::net
@@ -1,9 +1,12 @@
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <fmt/chrono.h>
 #include <fmt/core.h>
-#include <fstream>
+#include <limits>
 #include <spdlog/spdlog.h>
 
+#include <lily/core/Constants.h>
 #include <lily/core/ErrorCode.h>
 #include <lily/log/ServerLog.h>
 #include <lily/net/ServerSession.h>
@@ -13,21 +16,54 @@ using namespace lily::log;
 
 namespace lily::net
 {
+    // Identifies the connections in the server log and the trace log
+    static std::atomic_uint64_t NEXT_CONNECTION_ID {};
+
+    ServerSession::ServerSession(boost::asio::ip::tcp::socket&& socket, boost::asio::ssl::context& ctx,
+                                 CryptoPool* cryptoPool, bool traceHandshake, CertificateStore* certificates,
+                                 bool ktls):
+        stream(std::move(socket), ctx, ktls), cryptoPool(cryptoPool), certificates(certificates),
+        connectionId(NEXT_CONNECTION_ID.fetch_add(1, std::memory_order_relaxed)),
+        traceHandshake(traceHandshake)
+    {
+    }
+
     void ServerSession::run()
     {
-        // Variable that collect the error code thrown by boost function
-        boost::beast::error_code ec {};
+        // We need to be executing within a strand to perform async operations on the I/O objects in this session.
+        boost::asio::dispatch(this->stream.get_executor(),
+                              boost::beast::bind_front_handler(&ServerSession::onRun, this->shared_from_this()));
+    }
 
+    void ServerSession::onRun()
+    {
         // Set the timeout.
         boost::beast::get_lowest_layer(this->stream).expires_never();
 
         // Perform the SSL handshake and measure the handshake time using `std::chrono`. This will measure the whole
         // handshake process duration.
-        auto beginHandshakeTime {std::chrono::high_resolution_clock::now()};
-        this->stream.handshake(boost::asio::ssl::stream_base::server, ec);
-        auto handshakeDuration {std::chrono::duration_cast<std::chrono::microseconds>(
-                                    std::chrono::high_resolution_clock::now() - beginHandshakeTime)
-                                    .count()};
+        this->beginTime = std::chrono::high_resolution_clock::now();
+        this->trace.attach(this->stream.native_handle());
+        if (this->cryptoPool == nullptr)
+            return this->stream.async_handshake(
+                boost::asio::ssl::stream_base::server,
+                boost::beast::bind_front_handler(&ServerSession::onHandshake, this->shared_from_this()));
+
+        // The intermediate handlers of the handshake run on the executor associated with the completion handler. By
+        // binding the handler to the crypto pool, every handshake step (including the signing and the encapsulation)
+        // runs there instead of blocking the I/O threads.
+        this->stream.async_handshake(
+            boost::asio::ssl::stream_base::server,
+            boost::asio::bind_executor(
+                this->cryptoPool->get_executor(),
+                boost::beast::bind_front_handler(&ServerSession::onHandshake, this->shared_from_this())));
+    }
+
+    void ServerSession::onHandshake(boost::beast::error_code ec)
+    {
+        this->handshakeDuration = std::chrono::duration_cast<std::chrono::microseconds>(
+                                      std::chrono::high_resolution_clock::now() - this->beginTime)
+                                      .count();
         if (ec)
         {
             if (ec != boost::beast::net::ssl::error::stream_truncated and ec != boost::asio::error::broken_pipe and
@@ -35,80 +71,245 @@ namespace lily::net
                 return spdlog::error("Lily-PQC server SSL handshake with client failed! Why: {}", ec.message());
             return;
         }
+        this->trace.finish(boost::beast::get_lowest_layer(this->stream).socket().native_handle());
+        if (this->traceHandshake)
+            this->trace.write(this->connectionId);
+
+        // Continue on the session strand, the handshake may have completed on the crypto pool
+        boost::asio::dispatch(this->stream.get_executor(),
+                              boost::beast::bind_front_handler(&ServerSession::doRead, this->shared_from_this()));
+    }
+
+    void ServerSession::doRead()
+    {
+        // Parse the header of the next request first, its body is read once the kind of request is known. The body
+        // is streamed, so its size is not limited.
+        this->serializer.reset();
+        this->echoParser.reset();
+        this->controlParser.reset();
+        this->headerParser.emplace();
+        this->headerParser->body_limit(std::numeric_limits<std::uint64_t>::max());
+        this->readSize      = 0;
+        this->readDuration  = 0;
+        this->writeSize     = 0;
+        this->writeDuration = 0;
+        this->trace.getPerf().reset(PerfSection::READ);
+        this->trace.getPerf().reset(PerfSection::WRITE);
 
-        while (true)
+        // Perform the SSL read and measure the duration
+        this->beginTime = std::chrono::high_resolution_clock::now();
+        boost::beast::http::async_read_header(
+            this->stream, this->buffer, *this->headerParser,
+            boost::beast::bind_front_handler(&ServerSession::onReadHeader, this->shared_from_this()));
+    }
+
+    void ServerSession::onReadHeader(boost::beast::error_code ec, std::size_t bytesTransferred)
+    {
+        this->trace.getPerf().update(PerfSection::READ);
+        this->readSize += bytesTransferred;
+        this->readDuration += std::chrono::duration_cast<std::chrono::microseconds>(
+                                  std::chrono::high_resolution_clock::now() - this->beginTime)
+                                  .count();
+        if (ec == boost::beast::http::error::end_of_stream)
+            return this->close();
+        if (ec)
+            return;
+
+        // Create empty HTTP response
+        auto const& req {this->headerParser->get()};
+        this->res = {boost::beast::http::status::bad_request, req.version()};
+        this->res.set(boost::beast::http::field::server, BOOST_BEAST_VERSION_STRING);
+        this->res.set(boost::beast::http::field::content_type, "text/plain");
+        this->res.set(boost::beast::http::field::connection, req.keep_alive() ? "keep-alive" : "close");
+        this->res.keep_alive(req.keep_alive());
+
+        // A control request is read whole, as its body is parsed at once. Its body is limited to the size of a
+        // certificate chain and its key, a larger one is refused instead of buffered.
+        if (this->certificates != nullptr and req.method() == boost::beast::http::verb::post and
+            req.target() == constants::CONTROL_CREDENTIALS_TARGET)
         {
-            boost::beast::http::request<boost::beast::http::string_body> req {};
-
-            // Perform the SSL read and measure the duration
-            auto beginReadTime {std::chrono::high_resolution_clock::now()};
-            auto readSize {boost::beast::http::read(this->stream, this->buffer, req, ec)};
-            auto readDuration {std::chrono::duration_cast<std::chrono::microseconds>(
-                                   std::chrono::high_resolution_clock::now() - beginReadTime)
-                                   .count()};
-            if (ec == boost::beast::http::error::end_of_stream)
-                break;
-            if (ec)
-                return;
-
-            // Handle request
-            boost::beast::http::message_generator msg {
-                [](boost::beast::http::request<boost::beast::http::string_body>&& req)
-                    -> boost::beast::http::message_generator
-                {
-                    // Create empty HTTP response
-                    boost::beast::http::response<boost::beast::http::string_body> res {
-                        boost::beast::http::status::bad_request, req.version()};
-                    res.set(boost::beast::http::field::server, BOOST_BEAST_VERSION_STRING);
-                    res.set(boost::beast::http::field::content_type, "text/plain");
-                    res.set(boost::beast::http::field::connection, req.keep_alive() ? "keep-alive" : "close");
-                    res.keep_alive(req.keep_alive());
-
-                    // Echo the body sent by the client
-                    res.body().assign(std::move(req.body()));
-                    res.prepare_payload();
-                    return res;
-                }(std::move(req))};
-
-            // Determine if we should close the connection
-            bool keep_alive {msg.keep_alive()};
-
-            // Send the response
-            auto beginWriteTime {std::chrono::high_resolution_clock::now()};
-            auto writeSize {boost::beast::write(this->stream, std::move(msg), ec)};
-            auto writeDuration {std::chrono::duration_cast<std::chrono::microseconds>(
-                                    std::chrono::high_resolution_clock::now() - beginWriteTime)
-                                    .count()};
-            if (ec)
-            {
-                if (ec != boost::beast::net::ssl::error::stream_truncated and ec != boost::asio::error::broken_pipe and
-                    ec != boost::asio::error::connection_reset)
-                    return spdlog::error("Lily-PQC server SSL write to client failed! Why: {}", ec.message());
-                return;
-            }
-
-            // Log server SSL performance
-            ServerLog::getInstance().write(handshakeDuration, readSize, readDuration, writeSize, writeDuration);
-
-            if (!keep_alive)
-            {
-                // This means we should close the connection, usually because
-                // the response indicated the "Connection: close" semantic.
-                break;
-            }
+            this->controlParser.emplace(std::move(*this->headerParser));
+            this->controlParser->body_limit(constants::CONTROL_BODY_LIMIT);
+            if (this->controlParser->content_length().value_or(0) > constants::CONTROL_BODY_LIMIT)
+                return this->rejectControl();
+            this->beginTime = std::chrono::high_resolution_clock::now();
+            return boost::beast::http::async_read(
+                this->stream, this->buffer, *this->controlParser,
+                boost::beast::bind_front_handler(&ServerSession::onReadControl, this->shared_from_this()));
         }
 
-        // Perform the SSL shutdown
-        return this->close();
+        // Echo the body sent by the client with the same framing, relaying it one chunk at a time
+        this->echoParser.emplace(std::move(*this->headerParser));
+        if (this->echoParser->chunked())
+            this->res.chunked(true);
+        else
+            this->res.content_length(this->echoParser->content_length().value_or(0));
+        this->chunk.resize(static_cast<std::size_t>(
+            std::min<uint64_t>(this->echoParser->content_length().value_or(constants::BODY_CHUNK_SIZE),
+                               constants::BODY_CHUNK_SIZE)));
+        this->serializer.emplace(this->res);
+        this->doReadChunk();
     }
 
-    void ServerSession::close()
+    void ServerSession::doReadChunk()
+    {
+        // The header of the response is sent with the first chunk, or alone when the body is empty
+        if (this->echoParser->is_done())
+            return this->doWrite(nullptr, 0, false);
+
+        auto& body {this->echoParser->get().body()};
+        body.data       = this->chunk.data();
+        body.size       = this->chunk.size();
+        this->beginTime = std::chrono::high_resolution_clock::now();
+        boost::beast::http::async_read(
+            this->stream, this->buffer, *this->echoParser,
+            boost::beast::bind_front_handler(&ServerSession::onReadChunk, this->shared_from_this()));
+    }
+
+    void ServerSession::onReadChunk(boost::beast::error_code ec, std::size_t bytesTransferred)
     {
-        // Variable that collect the error code thrown by boost function
-        boost::beast::error_code ec {};
+        this->trace.getPerf().update(PerfSection::READ);
+        this->readSize += bytesTransferred;
+        this->readDuration += std::chrono::duration_cast<std::chrono::microseconds>(
+                                  std::chrono::high_resolution_clock::now() - this->beginTime)
+                                  .count();
 
+        // A full chunk is not an error, it is sent before the next one is read
+        if (ec == boost::beast::http::error::need_buffer)
+            ec = {};
+        if (ec)
+            return;
+
+        this->doWrite(this->chunk.data(), this->chunk.size() - this->echoParser->get().body().size,
+                      !this->echoParser->is_done());
+    }
+
+    void ServerSession::onReadControl(boost::beast::error_code ec, std::size_t bytesTransferred)
+    {
+        this->trace.getPerf().update(PerfSection::READ);
+        this->readSize += bytesTransferred;
+        this->readDuration += std::chrono::duration_cast<std::chrono::microseconds>(
+                                  std::chrono::high_resolution_clock::now() - this->beginTime)
+                                  .count();
+        if (ec == boost::beast::http::error::body_limit)
+            return this->rejectControl();
+        if (ec)
+            return;
+
+        auto message {this->onControl()};
+        this->res.content_length(message.size());
+        this->serializer.emplace(this->res);
+        this->doWrite(message.data(), message.size(), false);
+    }
+
+    std::string_view ServerSession::onControl()
+    {
+        // The body holds the PEM certificate chain and private key served by the following handshakes
+        auto credentials {this->certificates->parse(this->controlParser->get().body())};
+        if (!credentials)
+            return "Invalid credentials";
+
+        this->certificates->replace({std::move(credentials).value()});
+        this->res.result(boost::beast::http::status::ok);
+        spdlog::info("Lily-PQC server certificate replaced through the control target");
+        return {};
+    }
+
+    void ServerSession::rejectControl()
+    {
+        // The rest of the body is never read, so the connection cannot carry another request
+        static constexpr std::string_view MESSAGE {"Credentials too large"};
+        this->res.result(boost::beast::http::status::payload_too_large);
+        this->res.set(boost::beast::http::field::connection, "close");
+        this->res.keep_alive(false);
+        this->res.content_length(MESSAGE.size());
+        this->serializer.emplace(this->res);
+        this->doWrite(MESSAGE.data(), MESSAGE.size(), false);
+    }
+
+    void ServerSession::doWrite(void const* data, std::size_t size, bool more)
+    {
+        // Send the response, or the next chunk of its body
+        this->res.body().data = const_cast<void*>(data);
+        this->res.body().size = size;
+        this->res.body().more = more;
+        this->beginTime       = std::chrono::high_resolution_clock::now();
+        boost::beast::http::async_write(
+            this->stream, *this->serializer,
+            boost::beast::bind_front_handler(&ServerSession::onWrite, this->shared_from_this()));
+    }
+
+    void ServerSession::onWrite(boost::beast::error_code ec, std::size_t bytesTransferred)
+    {
+        this->trace.getPerf().update(PerfSection::WRITE);
+        this->writeSize += bytesTransferred;
+        this->writeDuration += std::chrono::duration_cast<std::chrono::microseconds>(
+                                   std::chrono::high_resolution_clock::now() - this->beginTime)
+                                   .count();
+
+        // The chunk was sent, the serializer waits for the next one
+        if (ec == boost::beast::http::error::need_buffer)
+            ec = {};
+        if (ec)
+        {
+            if (ec != boost::beast::net::ssl::error::stream_truncated and ec != boost::asio::error::broken_pipe and
+                ec != boost::asio::error::connection_reset)
+                return spdlog::error("Lily-PQC server SSL write to client failed! Why: {}", ec.message());
+            return;
+        }
+        if (!this->serializer->is_done())
+            return this->doReadChunk();
+
+        // Log server SSL performance, the handshake is only accounted to the first request of the connection
+        auto accounting {this->handshakeDuration >= 0 ? this->trace.getAccounting() : HandshakeTrace::Accounting {}};
+        auto const& perf {this->trace.getPerf()};
+        ServerLog::getInstance().write({.connId          = this->connectionId,
+                                        .hsDurationUs    = this->handshakeDuration,
+                                        .recvSize        = this->readSize,
+                                        .recvDurationUs  = this->readDuration,
+                                        .writeSize       = this->writeSize,
+                                        .writeDurationUs = this->writeDuration,
+                                        .resumed         = SSL_session_reused(this->stream.native_handle()) == 1,
+                                        .hsBytesSent     = accounting.bytesSent,
+                                        .hsBytesRecv     = accounting.bytesReceived,
+                                        .hsRecordsSent   = accounting.recordsSent,
+                                        .hsRecordsRecv   = accounting.recordsReceived,
+                                        .hsFlights       = accounting.flights,
+                                        .rttUs           = accounting.rttUs,
+                                        .retransmits     = accounting.retransmits,
+                                        .hsMemBytes      = accounting.memBytes,
+                                        .hsMemPeak       = accounting.memPeak,
+                                        .hsMemAllocs     = accounting.memAllocations,
+                                        .hsPerf          = this->handshakeDuration >= 0
+                                                               ? perf.getCounts(PerfSection::HANDSHAKE)
+                                                               : PerfCounts {},
+                                        .recvPerf        = perf.getCounts(PerfSection::READ),
+                                        .writePerf       = perf.getCounts(PerfSection::WRITE),
+                                        .ktlsSend        = this->stream.isKernelSend(),
+                                        .ktlsRecv        = this->stream.isKernelReceive()});
+
+        this->handshakeDuration = -1;
+
+        if (!this->res.keep_alive())
+        {
+            // This means we should close the connection, usually because
+            // the response indicated the "Connection: close" semantic.
+            return this->close();
+        }
+
+        // Read another request
+        this->doRead();
+    }
+
+    void ServerSession::close()
+    {
         // Perform the SSL shutdown
-        this->stream.shutdown(ec);
+        this->stream.async_shutdown(
+            boost::beast::bind_front_handler(&ServerSession::onShutdown, this->shared_from_this()));
+    }
+
+    void ServerSession::onShutdown(boost::beast::error_code ec)
+    {
         if (ec)
         {
             if (ec != boost::beast::net::ssl::error::stream_truncated and ec != boost::asio::error::broken_pipe and
@@ -116,4 +317,4 @@ namespace lily::net
                 return spdlog::error("Lily-PQC server SSL shutdown to client failed! Why: {}", ec.message());
         }
     }
-} // namespace lily::net
\ No newline at end of file
+} // namespace lily::net
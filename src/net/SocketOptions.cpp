@@ -0,0 +1,35 @@
+#include <spdlog/spdlog.h>
+
+#include <lily/net/SocketOptions.h>
+
+using namespace lily::core;
+
+namespace lily::net
+{
+    Expect<void> applySocketOptions(boost::asio::ip::tcp::socket& socket, SocketOptions const& options)
+    {
+        // Variable that collect the error code thrown by boost function
+        boost::system::error_code ec {};
+
+        if (options.noDelay)
+        {
+            std::ignore = socket.set_option(boost::asio::ip::tcp::no_delay(true), ec);
+            if (ec)
+            {
+                spdlog::error("Lily-PQC set_option TCP_NODELAY failed! Why: {}", ec.message());
+                return ErrorCode::LILY_ERRORCODE_EXPECTED;
+            }
+        }
+
+        if (options.lingerSeconds >= 0)
+        {
+            std::ignore = socket.set_option(boost::asio::socket_base::linger(true, options.lingerSeconds), ec);
+            if (ec)
+            {
+                spdlog::error("Lily-PQC set_option SO_LINGER failed! Why: {}", ec.message());
+                return ErrorCode::LILY_ERRORCODE_EXPECTED;
+            }
+        }
+        return success;
+    }
+} // namespace lily::net
@@ -0,0 +1,110 @@
+#include <fstream>
+#include <spdlog/spdlog.h>
+#include <string>
+
+#include <lily/net/TlsStream.h>
+
+using namespace lily::core;
+
+namespace lily::net
+{
+    TlsStream::SocketStream::SocketStream(next_layer_type&& next, boost::asio::ssl::context& ctx):
+        next {std::move(next)}, ssl {SSL_new(ctx.native_handle()), &SSL_free}
+    {
+        // Behave like `boost::asio::ssl::stream`, returning after every record and retrying from the same buffer
+        SSL_set_mode(this->ssl.get(), SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    }
+
+    TlsStream::TlsStream(boost::asio::ip::tcp::socket&& socket, boost::asio::ssl::context& ctx, bool ktls):
+        stream {makeStream(next_layer_type {std::move(socket)}, ctx, ktls)}
+    {
+    }
+
+    TlsStream::TlsStream(executor_type const& executor, boost::asio::ssl::context& ctx, bool ktls):
+        stream {makeStream(next_layer_type {executor}, ctx, ktls)}
+    {
+    }
+
+    std::variant<TlsStream::SslStream, TlsStream::SocketStream> TlsStream::makeStream(next_layer_type&& next,
+                                                                                      boost::asio::ssl::context& ctx,
+                                                                                      bool ktls)
+    {
+        // A connection without kTLS keeps the stream of Asio, so the default data path is unchanged
+        if (ktls)
+            return std::variant<SslStream, SocketStream> {std::in_place_type<SocketStream>, std::move(next), ctx};
+        return std::variant<SslStream, SocketStream> {std::in_place_type<SslStream>, std::move(next), ctx};
+    }
+
+    Expect<void> TlsStream::enableKtls([[maybe_unused]] SSL_CTX* ctx)
+    {
+#if defined(SSL_OP_ENABLE_KTLS) and !defined(OPENSSL_NO_KTLS)
+        SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+
+        // The kernel lists the upper layer protocols it can attach to a TCP socket once their module is loaded
+        std::ifstream available {"/proc/sys/net/ipv4/tcp_available_ulp"};
+        std::string protocol {};
+        while (available >> protocol)
+            if (protocol == "tls")
+                return success;
+        spdlog::warn("kTLS is not available, the `tls` kernel module is not loaded (modprobe tls). The records are "
+                     "encrypted by OpenSSL instead");
+        return success;
+#else
+        spdlog::error("kTLS is not supported by the linked OpenSSL ({})", OPENSSL_VERSION_TEXT);
+        return ErrorCode::LILY_ERRORCODE_EXPECTED;
+#endif
+    }
+
+    boost::system::error_code TlsStream::getError()
+    {
+        // OpenSSL 3 reports a connection closed without a close notify as an error, Asio as a truncated stream
+        auto error {ERR_peek_last_error()};
+        if (ERR_GET_LIB(error) == ERR_LIB_SSL and ERR_GET_REASON(error) == SSL_R_UNEXPECTED_EOF_WHILE_READING)
+            return boost::asio::ssl::error::stream_truncated;
+        if (error != 0)
+            return {static_cast<int>(ERR_get_error()), boost::asio::error::get_ssl_category()};
+        if (errno != 0)
+            return {errno, boost::system::system_category()};
+        return boost::asio::ssl::error::stream_truncated;
+    }
+
+    void TlsStream::attachSocket()
+    {
+        // OpenSSL reads and writes the socket itself, and must not block the thread while the socket is not ready
+        auto& socketStream {std::get<SocketStream>(this->stream)};
+        boost::system::error_code ignored {};
+        std::ignore = socketStream.next.socket().non_blocking(true, ignored);
+        SSL_set_fd(socketStream.ssl.get(), static_cast<int>(socketStream.next.socket().native_handle()));
+    }
+
+    TlsStream::executor_type TlsStream::get_executor() noexcept
+    {
+        return this->next_layer().get_executor();
+    }
+
+    TlsStream::next_layer_type& TlsStream::next_layer() noexcept
+    {
+        if (auto* sslStream {std::get_if<SslStream>(&this->stream)})
+            return sslStream->next_layer();
+        return std::get<SocketStream>(this->stream).next;
+    }
+
+    SSL* TlsStream::native_handle() noexcept
+    {
+        if (auto* sslStream {std::get_if<SslStream>(&this->stream)})
+            return sslStream->native_handle();
+        return std::get<SocketStream>(this->stream).ssl.get();
+    }
+
+    bool TlsStream::isKernelSend() noexcept
+    {
+        auto* bio {SSL_get_wbio(this->native_handle())};
+        return bio != nullptr and BIO_get_ktls_send(bio);
+    }
+
+    bool TlsStream::isKernelReceive() noexcept
+    {
+        auto* bio {SSL_get_rbio(this->native_handle())};
+        return bio != nullptr and BIO_get_ktls_recv(bio);
+    }
+} // namespace lily::net